@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include "util.h" //fast rand, timer
+
+
+typedef long hasht_key_type; 
+typedef long hasht_value_type; 
+
+static size_t hasht_hash(hasht_key_type *key) {
+    //identity, like in tests/hasht_test.c
+    return (size_t) *key;
+}
+
+//must return zero when equal
+static int hasht_key_eq_cmp(hasht_key_type *key_1, hasht_key_type *key_2) {
+    return !(*key_1 == *key_2);
+}
+
+#include "../src/hasht.h"
+
+#define NKEYS 1000000
+
+//same as the default malloc, but the table can't tell, so it clears the buckets itself
+static void *plain_malloc(size_t sz, void *userdata) {
+    (void) userdata;
+    return malloc(sz);
+}
+
+int main(void) {
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+
+    long *keys = malloc(NKEYS * sizeof *keys);
+    assert(keys);
+    xorshf96_srand(0xbeeffeed);
+    for (long i=0; i<NKEYS; i++) {
+        //distinct keys, a mix of small sequential values and random ones
+        keys[i] = (i & 1) ? i : (long) ((xorshf96() << 21) | (unsigned long) i);
+    }
+
+    struct timer_info tm_init;
+    struct timer_info tm_tmp;
+    timer_begin(&tm_init);
+    timer_begin(&tm_tmp);
+
+    for (long i=0; i<NKEYS; i++) {
+        int rv = hasht_insert(&ht, &keys[i], &i);
+        assert(rv == HASHT_OK);
+    }
+    printf("insertion time: %f\n", timer_dt(&tm_tmp));
+    timer_begin(&tm_tmp);
+    xorshf96_srand(0xfeedbeef);
+    int tlb_fd = tlb_counter_open();
+    long long tlb_before = tlb_counter_read(tlb_fd);
+
+    for (long i=0; i<NKEYS; i++) {
+        long idx = xorshf96() % NKEYS;
+        long key = keys[idx];
+        struct hasht_iter iter;
+        int rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK);
+        assert(*iter.value == idx);
+    }
+    printf("lookup time:    %f\n", timer_dt(&tm_tmp));
+    long long tlb_after = tlb_counter_read(tlb_fd);
+    if (tlb_after >= 0)
+        printf("lookup dTLB misses: %lld\n", tlb_after - tlb_before);
+    else
+        printf("lookup dTLB misses: n/a (no hardware counters)\n");
+    printf("huge pages:     %ld kB\n", anon_huge_kb());
+    if (tlb_fd >= 0)
+        close(tlb_fd);
+    timer_begin(&tm_tmp);
+
+    //same random lookups, BATCH keys at a time
+    #define BATCH 32
+    long batch_keys[BATCH];
+    long batch_idx[BATCH];
+    struct hasht_iter batch_iters[BATCH];
+    xorshf96_srand(0xfeedbeef);
+    for (long i=0; i<NKEYS; i += BATCH) {
+        long n = NKEYS - i < BATCH ? NKEYS - i : BATCH;
+        for (long j=0; j<n; j++) {
+            batch_idx[j] = xorshf96() % NKEYS;
+            batch_keys[j] = keys[batch_idx[j]];
+        }
+        int rv = hasht_find_batch(&ht, batch_keys, n, batch_iters);
+        assert(rv == HASHT_OK);
+        for (long j=0; j<n; j++) {
+            assert(batch_iters[j].pair);
+            assert(*batch_iters[j].value == batch_idx[j]);
+        }
+    }
+    printf("batched lookup: %f\n", timer_dt(&tm_tmp));
+
+#ifdef HASHT_SNAPSHOT
+    //instead of inserting everything again, map a saved copy and look up through it (page faults, the file is in the page cache)
+    char path[] = "/tmp/bench_ints_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    timer_begin(&tm_tmp);
+    rv = hasht_save(&ht, fd);
+    assert(rv == HASHT_OK);
+    close(fd);
+    printf("save time:      %f\n", timer_dt(&tm_tmp));
+    timer_begin(&tm_tmp);
+    struct hasht mapped;
+    rv = hasht_open_mapped(&mapped, path, false);
+    assert(rv == HASHT_OK);
+    printf("open mapped:    %f\n", timer_dt(&tm_tmp));
+    timer_begin(&tm_tmp);
+    xorshf96_srand(0xfeedbeef);
+    for (long i=0; i<NKEYS; i++) {
+        long idx = xorshf96() % NKEYS;
+        struct hasht_iter iter;
+        int rv = hasht_find(&mapped, &keys[idx], &iter);
+        assert(rv == HASHT_OK);
+        assert(*iter.value == idx);
+    }
+    printf("mapped lookup:  %f\n", timer_dt(&tm_tmp));
+    hasht_deinit(&mapped);
+    unlink(path);
+#endif
+    timer_begin(&tm_tmp);
+    for (long i=NKEYS-1; i>=0; i--) {
+        int rv = hasht_remove(&ht, &keys[i]);
+        assert(rv == HASHT_OK);
+    }
+    printf("deletion time:  %f\n", timer_dt(&tm_tmp));
+#ifdef HASHT_STATS
+    //what the phases above cost, compare the times with bench_ints_O2_NDEBUG for the overhead of counting
+    struct hasht_stats st;
+    hasht_get_stats(&ht, &st);
+    printf("finds: %ld  hits: %ld  misses: %ld  fingerprint false positives: %ld\n",
+           st.finds, st.hits, st.misses, st.fingerprint_false_positives);
+    printf("probe lengths:");
+    for (int i=0; i<HASHT_STATS_PROBE_HIST; i++)
+        printf(" %ld", st.probe_len_hist[i]);
+    printf("\n");
+    printf("deleted buckets created: %ld  reused: %ld  reclaimed: %ld  purged: %ld\n",
+           st.tombstones_created, st.tombstones_reused, st.tombstones_reclaimed, st.tombstones_purged);
+    printf("resizes: %ld  bytes: %ld  time: %f\n", st.resizes, st.resize_bytes, st.resize_ns / 1e9);
+#endif
+
+    //fill a fresh table timing each insert on its own, a resize shows up as one slow insert
+    hasht_deinit(&ht);
+    rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+    double slowest_insert = 0.0;
+    for (long i=0; i<NKEYS; i++) {
+        timer_begin(&tm_tmp);
+        int rv = hasht_insert(&ht, &keys[i], &i);
+        double dt = timer_dt(&tm_tmp);
+        assert(rv == HASHT_OK);
+        slowest_insert = dt > slowest_insert ? dt : slowest_insert;
+    }
+    printf("slowest insert: %f\n", slowest_insert);
+    hasht_deinit(&ht);
+
+    //a table presized for far more than it gets, with the buckets zeroed lazily by calloc (the default)
+    //and cleared up front (any allocator without a zalloc), only the pages that are written to become resident
+    for (int zeroed=1; zeroed>=0; zeroed--) {
+        long rss_before = rss_kb();
+        timer_begin(&tm_tmp);
+        rv = hasht_init_ex(&ht, 16 * NKEYS, zeroed ? hasht_def_malloc : plain_malloc, hasht_def_realloc, hasht_def_free, NULL, 20, 60);
+        assert(rv == HASHT_OK);
+        double init_dt = timer_dt(&tm_tmp);
+        for (long i=0; i<NKEYS / 16; i++) {
+            int rv = hasht_insert(&ht, &keys[i], &i);
+            assert(rv == HASHT_OK);
+        }
+        printf("presized %s init: %f  insert: %f  rss: +%ld kB\n", zeroed ? "calloc" : "memset",
+               init_dt, timer_dt(&tm_tmp) - init_dt, rss_kb() - rss_before);
+        hasht_deinit(&ht);
+    }
+    printf("total time:     %f\n", timer_dt(&tm_init));
+    printf("success\n");
+    free(keys);
+}
@@ -87,7 +87,14 @@ int main(void) {
         int sentence_cur = 0;
         for (int i=0; i<3; i++) 
             sentence_len += strlen(words[words_idx[i]]) + 1;
+#ifdef HASHT_STR_VALUES
+        //the table copies it into its own arena
+        char sentence_buff[1024];
+        assert(sentence_len <= (int) sizeof sentence_buff);
+        char *sentence = sentence_buff;
+#else
         char *sentence = xmalloc(sentence_len);
+#endif
         for (int i=0; i<3; i++) {
             const char *word = words[words_idx[i]];
             memcpy(sentence + sentence_cur, word, strlen(word));
@@ -127,8 +134,10 @@ int main(void) {
                 continue;
             }
             assert(it.pair->value);
+#ifndef HASHT_STR_VALUES
             free(it.pair->value);
-            rv = hasht_remove(&ht, &next_word);
+#endif
+            rv = hasht_remove_iter(&ht, &it); //no second probe
             assert(rv == HASHT_OK);
         }
     }
@@ -150,7 +159,9 @@ int main(void) {
         assert(iter.pair->value);
         char *sentence = iter.pair->value;
         fprintf(fout, "%s\n", sentence);
+#ifndef HASHT_STR_VALUES
         free(sentence);
+#endif
     }
 
 
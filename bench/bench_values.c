@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include "util.h" //fast rand, timer
+
+//int keys with VALUE_SZ byte values, built once per value size with and without HASHT_SOA (make bench_value_sweep)
+#ifndef VALUE_SZ
+#define VALUE_SZ 64
+#endif
+
+typedef long hasht_key_type;
+typedef struct { long idx; char bytes[VALUE_SZ - sizeof(long)]; } hasht_value_type;
+
+static size_t hasht_hash(hasht_key_type *key) {
+    //identity, like in bench_ints.c
+    return (size_t) *key;
+}
+
+//must return zero when equal
+static int hasht_key_eq_cmp(hasht_key_type *key_1, hasht_key_type *key_2) {
+    return !(*key_1 == *key_2);
+}
+
+#include "../src/hasht.h"
+
+#define NKEYS 400000
+
+int main(void) {
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+
+    //the first NKEYS are inserted, the second NKEYS are looked up and missed
+    long *keys = malloc(2 * NKEYS * sizeof *keys);
+    assert(keys);
+    xorshf96_srand(0xbeeffeed);
+    for (long i=0; i<2 * NKEYS; i++)
+        keys[i] = (long) ((xorshf96() << 21) | (unsigned long) i);
+
+    struct timer_info tm_tmp;
+    timer_begin(&tm_tmp);
+    hasht_value_type value;
+    memset(&value, 0, sizeof value);
+    for (long i=0; i<NKEYS; i++) {
+        value.idx = i;
+        int rv = hasht_insert(&ht, &keys[i], &value);
+        assert(rv == HASHT_OK);
+    }
+    double insert_dt = timer_dt(&tm_tmp);
+
+    timer_begin(&tm_tmp);
+    xorshf96_srand(0xfeedbeef);
+    long sum = 0;
+    for (long i=0; i<NKEYS; i++) {
+        long idx = xorshf96() % NKEYS;
+        struct hasht_iter iter;
+        int rv = hasht_find(&ht, &keys[idx], &iter);
+        assert(rv == HASHT_OK);
+        assert(iter.value->idx == idx);
+        sum += iter.value->idx;
+    }
+    double hit_dt = timer_dt(&tm_tmp);
+
+    timer_begin(&tm_tmp);
+    for (long i=0; i<NKEYS; i++) {
+        long idx = NKEYS + xorshf96() % NKEYS;
+        struct hasht_iter iter;
+        int rv = hasht_find(&ht, &keys[idx], &iter);
+        assert(rv == HASHT_NOT_FOUND);
+        (void) rv;
+    }
+    double miss_dt = timer_dt(&tm_tmp);
+
+#ifdef HASHT_SOA
+    const char *layout = "soa";
+#else
+    const char *layout = "aos";
+#endif
+    printf("value size: %4d  layout: %s  insert: %f  hit lookup: %f  miss lookup: %f  (%ld)\n",
+           VALUE_SZ, layout, insert_dt, hit_dt, miss_dt, sum);
+    hasht_deinit(&ht);
+    free(keys);
+}
@@ -24,6 +24,21 @@ static int hasht_key_eq_cmp(hasht_key_type *key_1, hasht_key_type *key_2) {
     return strcmp(*key_1, *key_2);
 }
 
+//lookups by (pointer, length) slices of a buffer that isn't NUL terminated between keys
+#define HASHT_PROBE
+typedef struct {
+    const char *ptr;
+    int len;
+} hasht_probe_type;
+
+static size_t hasht_probe_hash(hasht_probe_type *probe) {
+    return SuperFastHash(probe->ptr, probe->len); //same as hasht_hash() for the same characters
+}
+
+static int hasht_probe_eq_cmp(hasht_probe_type *probe, hasht_key_type *key) {
+    return strncmp(*key, probe->ptr, probe->len) != 0 || (*key)[probe->len] != '\0';
+}
+
 #include "../src/hasht.h"
 
 int main(void) {
@@ -57,10 +72,78 @@ int main(void) {
         int rv = hasht_find(&ht, &keycpy, &iter);
         assert(rv == HASHT_OK);
         assert(iter.pair->key == key);
-        assert(iter.pair->value == idx);
+        assert(*iter.value == idx);
     }
     printf("lookup time:    %f\n", timer_dt(&tm_tmp));
     timer_begin(&tm_tmp);
+
+    //same random lookups, BATCH keys at a time
+    #define BATCH 32
+    static char batch_buffs[BATCH][256];
+    const char *batch_keys[BATCH];
+    int batch_idx[BATCH];
+    struct hasht_iter batch_iters[BATCH];
+    xorshf96_srand(0xfeedbeef);
+    for (int i=0; i<nwords; i += BATCH) {
+        int n = nwords - i < BATCH ? nwords - i : BATCH;
+        for (int j=0; j<n; j++) {
+            batch_idx[j] = xorshf96() % nwords;
+            assert(strlen(words[batch_idx[j]]) < keybuff_sz);
+            strcpy(batch_buffs[j], words[batch_idx[j]]);
+            batch_keys[j] = batch_buffs[j];
+        }
+        int rv = hasht_find_batch(&ht, batch_keys, n, batch_iters);
+        assert(rv == HASHT_OK);
+        for (int j=0; j<n; j++) {
+            assert(batch_iters[j].pair);
+            assert(batch_iters[j].pair->key == words[batch_idx[j]]);
+            assert(*batch_iters[j].value == batch_idx[j]);
+        }
+    }
+    printf("batched lookup: %f\n", timer_dt(&tm_tmp));
+
+    //every word back to back, like keys in a receive buffer
+    int *word_offs = malloc(sizeof(int) * (nwords + 1));
+    assert(word_offs);
+    word_offs[0] = 0;
+    for (int i=0; i<nwords; i++)
+        word_offs[i + 1] = word_offs[i] + (int) strlen(words[i]);
+    char *slices = malloc(word_offs[nwords]);
+    assert(slices);
+    for (int i=0; i<nwords; i++)
+        memcpy(slices + word_offs[i], words[i], word_offs[i + 1] - word_offs[i]);
+    timer_begin(&tm_tmp);
+    xorshf96_srand(0xfeedbeef);
+    for (int i=0; i<nwords; i++) {
+        int idx = xorshf96() % nwords;
+        hasht_probe_type probe = { slices + word_offs[idx], word_offs[idx + 1] - word_offs[idx] };
+        struct hasht_iter iter;
+        int rv = hasht_find_as(&ht, &probe, &iter);
+        assert(rv == HASHT_OK);
+        assert(iter.pair->key == words[idx]);
+        assert(*iter.value == idx);
+    }
+    printf("slice lookup:   %f\n", timer_dt(&tm_tmp));
+    free(slices);
+    free(word_offs);
+
+    //word count, one probe per word whether it was seen before or not
+    timer_begin(&tm_tmp);
+    struct hasht counts;
+    rv = hasht_init(&counts, 0);
+    assert(rv == HASHT_OK);
+    xorshf96_srand(0xfeedbeef);
+    for (int i=0; i<nwords; i++) {
+        struct hasht_iter iter;
+        bool inserted;
+        int rv = hasht_try_emplace(&counts, &words[xorshf96() % nwords], NULL, &iter, &inserted);
+        assert(rv == HASHT_OK);
+        assert(!inserted || *iter.value == 0);
+        (*iter.value)++;
+    }
+    printf("counting time:  %f\n", timer_dt(&tm_tmp));
+    hasht_deinit(&counts);
+    timer_begin(&tm_tmp);
     for (int i=nwords-1; i>=0; i--) {
         const char *key = words[i];
         assert(strlen(key) < keybuff_sz);
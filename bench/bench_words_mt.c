@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "../third_party/strhash/superfasthash.h"
+#include "../third_party/data/words.h"
+#include "util.h" //timer
+
+
+typedef const char * hasht_key_type;
+typedef int hasht_value_type;
+
+static size_t hasht_hash(hasht_key_type *key) {
+    //key is passed as const char **
+    return SuperFastHash(*key, strlen(*key));
+}
+
+//must return zero when equal
+static int hasht_key_eq_cmp(hasht_key_type *key_1, hasht_key_type *key_2) {
+    //we are passed const char **
+    if (*key_1 == *key_2)
+        return 0; //equal
+    return strcmp(*key_1, *key_2);
+}
+
+#include "../src/hasht.h"
+
+//ops/sec of a mix of finds and writes on struct hasht_sharded, from 1 to MAX_THREADS threads
+//a write removes a random word and inserts it back, so the table keeps the same size
+//one shard is the same as wrapping the whole table in a single lock
+#define MAX_THREADS 64
+#define OPS_PER_THREAD 1000000
+
+struct worker_arg {
+    struct hasht_sharded *sh;
+    unsigned long seed;
+    int read_percentage;
+    pthread_barrier_t *start;
+};
+
+//xorshf96 in util.h keeps global state, every thread needs its own
+static unsigned long xorshift64(unsigned long *state) {
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static void *worker(void *varg) {
+    struct worker_arg *arg = (struct worker_arg *) varg;
+    unsigned long rng = arg->seed;
+    pthread_barrier_wait(arg->start);
+    for (long i=0; i<OPS_PER_THREAD; i++) {
+        unsigned long r = xorshift64(&rng);
+        int idx = (int) ((r >> 8) % nwords);
+        const char *key = words[idx];
+        if ((int) (r % 100) < arg->read_percentage) {
+            int value;
+            int rv = hasht_sharded_find(arg->sh, &key, &value);
+            //another thread may be between removing and inserting this word
+            assert(rv == HASHT_NOT_FOUND || (rv == HASHT_OK && value == idx));
+            (void) rv;
+        }
+        else {
+            int rv = hasht_sharded_remove(arg->sh, &key);
+            if (rv == HASHT_OK) {
+                rv = hasht_sharded_insert(arg->sh, &key, &idx);
+                assert(rv == HASHT_OK);
+            }
+        }
+    }
+    return NULL;
+}
+
+static double run(struct hasht_sharded *sh, int nthreads, int read_percentage) {
+    pthread_t threads[MAX_THREADS];
+    struct worker_arg args[MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, nthreads + 1);
+    for (int t=0; t<nthreads; t++) {
+        struct worker_arg arg = { sh, 0x9E3779B97F4A7C15UL * (t + 1), read_percentage, &start };
+        args[t] = arg;
+        int rv = pthread_create(threads + t, NULL, worker, args + t);
+        assert(rv == 0);
+        (void) rv;
+    }
+    struct timer_info tm;
+    pthread_barrier_wait(&start);
+    timer_begin(&tm);
+    for (int t=0; t<nthreads; t++)
+        pthread_join(threads[t], NULL);
+    double dt = timer_dt(&tm);
+    pthread_barrier_destroy(&start);
+    return (double) nthreads * OPS_PER_THREAD / dt;
+}
+
+int main(int argc, char **argv) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int) ncpus;
+    max_threads = max_threads < 1 ? 1 : (max_threads > MAX_THREADS ? MAX_THREADS : max_threads);
+    const int read_percentages[] = { 100, 90, 50 };
+    const long shard_counts[] = { 1, 64 };
+
+    for (int s=0; s < (int) (sizeof shard_counts / sizeof shard_counts[0]); s++) {
+        struct hasht_sharded sh;
+        int rv = hasht_sharded_init(&sh, shard_counts[s], nwords);
+        assert(rv == HASHT_OK);
+        for (int i=0; i<nwords; i++) {
+            rv = hasht_sharded_insert(&sh, &words[i], &i);
+            assert(rv == HASHT_OK);
+        }
+        for (int p=0; p < (int) (sizeof read_percentages / sizeof read_percentages[0]); p++) {
+            //powers of two, always ending with max_threads
+            for (int nthreads=1; nthreads<=max_threads; nthreads = (nthreads < max_threads && nthreads * 2 > max_threads) ? max_threads : nthreads * 2) {
+                printf("shards: %3ld  reads: %3d%%  threads: %3d  ops/sec: %.0f\n",
+                       sh.nshards, read_percentages[p], nthreads, run(&sh, nthreads, read_percentages[p]));
+            }
+        }
+        assert(hasht_sharded_nelements(&sh) == nwords);
+        hasht_sharded_deinit(&sh);
+    }
+    printf("success\n");
+}
@@ -45,4 +45,56 @@ static double timer_dt(struct timer_info *timer){
            ((double)timer->tstart.tv_sec + 1.0e-9 * timer->tstart.tv_nsec);
 }
 
+#ifdef __linux__
+#include <stdio.h>
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+//data TLB load misses of this thread (user space only), the fd is negative where the cpu or the vm doesn't expose them
+static int tlb_counter_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+static long long tlb_counter_read(int fd) {
+    long long count;
+    if (fd < 0 || read(fd, &count, sizeof count) != sizeof count)
+        return -1;
+    return count;
+}
+//kB of this process' anonymous memory backed by transparent huge pages
+static long anon_huge_kb(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f)
+        return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof line, f))
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            break;
+    fclose(f);
+    return kb;
+}
+//resident memory of this process
+static long rss_kb(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return -1;
+    long size, resident;
+    int n = fscanf(f, "%ld %ld", &size, &resident);
+    fclose(f);
+    return n == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+#else
+static long rss_kb(void) { return -1; }
+static int tlb_counter_open(void) { return -1; }
+static long long tlb_counter_read(int fd) { (void) fd; return -1; }
+static long anon_huge_kb(void) { return -1; }
+#endif
+
 #endif// UTILH
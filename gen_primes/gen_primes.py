@@ -21,7 +21,7 @@ parser = argparse.ArgumentParser(description='')
 parser.add_argument('--bits', type=int, nargs=1, metavar='B', help='what bitness')
 parser.add_argument('--tries', type=int, nargs=1, metavar='B', help='how many times should we try generating another number for each bit attempting to get a larger one')
 parser.add_argument('--prefix', nargs=1, help='what func name prefix')
-parser.add_argument('--mode', nargs=1, help='["values", "funcs", "switch", "switch_p"]')
+parser.add_argument('--mode', nargs=1, help='["values", "funcs", "switch", "switch_p", "fastmod"]')
 parser.add_argument('--no-values', help='disable printing the array', action='store_true')
 parser.add_argument('--no-ifndef', help='disable printing ifndef guard', action='store_true')
 parser.add_argument('--decl-modifier', nargs=1, help='defaults to static')
@@ -53,9 +53,11 @@ if args['bits']:
         sys.exit(1)
     bits = args['bits'][0]
 prefix='adiv'
+if args['prefix']:
+    prefix = args['prefix'][0]
 mode = 'values'
 if args['mode']:
-    if (args['mode'][0] not in ['values', 'funcs', 'switch', 'switch_p']):
+    if (args['mode'][0] not in ['values', 'funcs', 'switch', 'switch_p', 'fastmod']):
         print('unsupported mode: ', args['mode'])
         sys.exit(1)
     mode = args['mode'][0]
@@ -146,12 +148,63 @@ def mode_funcs(values):
 
     
     pass
+def mode_fastmod(values):
+    #Lemire's fastmod, for a 32 bit divisor d: magic = floor((2^64 - 1) / d) + 1
+    #then for any 32 bit n: n % d == (((magic * n) mod 2^64) * d) >> 64
+    #for 64 bit divisors the same is done with a 128 bit magic, which is split in two arrays (_magic_hi, _magic_lo)
+    if not with_values:
+        raise RuntimeError('generating this function would be meaningless without an array of values')
+    values = list(values)
+    #have array[0] and array[1] = 0 (a sentinel), same indices as the values array
+    if bits <= 32:
+        magics = [0, 0, *[((1 << 64) - 1) // v + 1 for v in values]]
+        print('{modifier}const uint64_t {pfx}_magic[] = {{'.format(pfx=prefix, modifier=decl_modifier))
+        for v in magics:
+            print('    0x{:016X}LLU,'.format(v))
+        print('};')
+        print('''
+/*returns dividend % divisor, magic must be {pfx}_magic[i] where divisor is {pfx}_values[i]*/
+{modifier}inline uint32_t {pfx}_fastmod(uint32_t dividend, uint64_t magic, uint32_t divisor) {{
+    uint64_t lowbits = magic * dividend;
+#if defined(__SIZEOF_INT128__)
+    return (uint32_t) (((__uint128_t) lowbits * divisor) >> 64);
+#else
+    /*high 64 bits of the 64x32 product*/
+    uint64_t lo = (lowbits & 0xFFFFFFFFLLU) * divisor;
+    uint64_t hi = (lowbits >> 32) * divisor;
+    return (uint32_t) ((hi + (lo >> 32)) >> 32);
+#endif
+}}
+'''.format(pfx=prefix, modifier=decl_modifier))
+        return
+    magics = [0, 0, *[((1 << 128) - 1) // v + 1 for v in values]]
+    for half, shift in (('hi', 64), ('lo', 0)):
+        print('{modifier}const uint64_t {pfx}_magic_{half}[] = {{'.format(pfx=prefix, modifier=decl_modifier, half=half))
+        for v in magics:
+            print('    0x{:016X}LLU,'.format((v >> shift) & ((1 << 64) - 1)))
+        print('};')
+    print('''
+/*returns dividend % divisor, magic_hi/lo must be {pfx}_magic_hi[i]/{pfx}_magic_lo[i] where divisor is {pfx}_values[i]*/
+{modifier}inline uint64_t {pfx}_fastmod(uint64_t dividend, uint64_t magic_hi, uint64_t magic_lo, uint64_t divisor) {{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t lowbits = ((((__uint128_t) magic_hi) << 64) | magic_lo) * dividend;
+    /*high 128 bits of the 128x64 product, shifted down by 64*/
+    __uint128_t bottom_half = ((lowbits & 0xFFFFFFFFFFFFFFFFLLU) * divisor) >> 64;
+    __uint128_t top_half = (lowbits >> 64) * divisor;
+    return (uint64_t) ((bottom_half + top_half) >> 64);
+#else
+    (void) magic_hi;
+    (void) magic_lo;
+    return dividend % divisor;
+#endif
+}}
+'''.format(pfx=prefix, modifier=decl_modifier))
 def mode_values(values):
     values = list(values)
     #have array[0] and array[1] = 0 (a sentinel)
     values = [0, 0, *values]
-    print('const {modifier}{int_type} {pfx}_n_values = {count};'.format(int_type=itype(), pfx=prefix, count=len(values), modifier=decl_modifier))
-    print('const {modifier}{int_type} {pfx}_values[] = {{'.format(int_type=itype(), pfx=prefix, modifier=decl_modifier))
+    print('{modifier}const {int_type} {pfx}_n_values = {count};'.format(int_type=itype(), pfx=prefix, count=len(values), modifier=decl_modifier))
+    print('{modifier}const {int_type} {pfx}_values[] = {{'.format(int_type=itype(), pfx=prefix, modifier=decl_modifier))
     lenline=0
     for i,v in enumerate(values):
         if (i > 0):
@@ -185,5 +238,7 @@ elif mode == 'switch':
     mode_switch(generated)
 elif mode == 'switch_p':
     mode_switch_p(generated)
+elif mode == 'fastmod':
+    mode_fastmod(generated)
 
 ifndefend()
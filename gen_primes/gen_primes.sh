@@ -1,5 +1,7 @@
 #!/bin/sh
 #this requires openssl
 ( make -f genprimes.mk && \
-    python3 gen_primes.py --mode=funcs --bits=32 --tries=70 > div_32_funcs_tmp.h && \
-    mv div_32_funcs_tmp.h div_32_funcs.h && echo 'generated div_32_funcs.h') || echo 'failed to generate header' && exit 1
+    python3 gen_primes.py --mode=fastmod --bits=32 --tries=70 > div_32_funcs_tmp.h && \
+    mv div_32_funcs_tmp.h div_32_funcs.h && echo 'generated div_32_funcs.h' && \
+    python3 gen_primes.py --mode=fastmod --bits=64 --prefix=adiv64 --tries=70 > div_64_funcs_tmp.h && \
+    mv div_64_funcs_tmp.h div_64_funcs.h && echo 'generated div_64_funcs.h') || echo 'failed to generate header' && exit 1
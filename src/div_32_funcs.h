@@ -13,80 +13,52 @@ static const uint32_t adiv_values[] = {
     3973787LU, 7759439LU, 16669799LU, 28668287LU, 62923067LU, 118960319LU, 230959907LU, 
     408026687LU, 994046939LU, 2139408407LU
 };
-typedef uint32_t (*adiv_fptr)(uint32_t dividend);
+static const uint64_t adiv_magic[] = {
+    0x0000000000000000LLU,
+    0x0000000000000000LLU,
+    0x8000000000000000LLU,
+    0x2492492492492493LLU,
+    0x13B13B13B13B13B2LLU,
+    0x0B21642C8590B217LLU,
+    0x04325C53EF368EB1LLU,
+    0x027C45979C952050LLU,
+    0x0105197F7D734042LLU,
+    0x00824A4E60B3262CLLU,
+    0x0042AB5C73A13459LLU,
+    0x00225DB37B5E5F50LLU,
+    0x001475F82AD6FF9ALLU,
+    0x0009D77AD449F778LLU,
+    0x00040A29908FA967LLU,
+    0x00028918E3CD5433LLU,
+    0x000127564DC142BDLLU,
+    0x0000A65CF1D1418FLLU,
+    0x00004AB48714548FLLU,
+    0x000025C95F1E12E0LLU,
+    0x000013A07CDCDE5BLLU,
+    0x00000947373CEF5ALLU,
+    0x00000438D32213A2LLU,
+    0x0000022983E30403LLU,
+    0x00000101A64D2CB5LLU,
+    0x00000095D0E39268LLU,
+    0x0000004441E767FFLLU,
+    0x000000241AACEE9BLLU,
+    0x00000012989DEAB0LLU,
+    0x0000000A86B486CCLLU,
+    0x000000045218A63BLLU,
+    0x0000000201EEBBE5LLU,
+};
 
-static uint32_t adiv_mod_0(uint32_t n) {
-    (void) n;
-    /*ERROR FUNCTION*/
-    //the error is non recoverable, and is only a result of memory corruption or a bug in the implementation
-    abort();
-    return 0;
+/*returns dividend % divisor, magic must be adiv_magic[i] where divisor is adiv_values[i]*/
+static inline uint32_t adiv_fastmod(uint32_t dividend, uint64_t magic, uint32_t divisor) {
+    uint64_t lowbits = magic * dividend;
+#if defined(__SIZEOF_INT128__)
+    return (uint32_t) (((__uint128_t) lowbits * divisor) >> 64);
+#else
+    /*high 64 bits of the 64x32 product*/
+    uint64_t lo = (lowbits & 0xFFFFFFFFLLU) * divisor;
+    uint64_t hi = (lowbits >> 32) * divisor;
+    return (uint32_t) ((hi + (lo >> 32)) >> 32);
+#endif
 }
-            
-static uint32_t adiv_mod_2(uint32_t dividend) { return dividend % 2; } 
-static uint32_t adiv_mod_3(uint32_t dividend) { return dividend % 7; } 
-static uint32_t adiv_mod_4(uint32_t dividend) { return dividend % 13; } 
-static uint32_t adiv_mod_5(uint32_t dividend) { return dividend % 23; } 
-static uint32_t adiv_mod_6(uint32_t dividend) { return dividend % 61; } 
-static uint32_t adiv_mod_7(uint32_t dividend) { return dividend % 103; } 
-static uint32_t adiv_mod_8(uint32_t dividend) { return dividend % 251; } 
-static uint32_t adiv_mod_9(uint32_t dividend) { return dividend % 503; } 
-static uint32_t adiv_mod_10(uint32_t dividend) { return dividend % 983; } 
-static uint32_t adiv_mod_11(uint32_t dividend) { return dividend % 1907; } 
-static uint32_t adiv_mod_12(uint32_t dividend) { return dividend % 3203; } 
-static uint32_t adiv_mod_13(uint32_t dividend) { return dividend % 6659; } 
-static uint32_t adiv_mod_14(uint32_t dividend) { return dividend % 16223; } 
-static uint32_t adiv_mod_15(uint32_t dividend) { return dividend % 25847; } 
-static uint32_t adiv_mod_16(uint32_t dividend) { return dividend % 56807; } 
-static uint32_t adiv_mod_17(uint32_t dividend) { return dividend % 100847; } 
-static uint32_t adiv_mod_18(uint32_t dividend) { return dividend % 224579; } 
-static uint32_t adiv_mod_19(uint32_t dividend) { return dividend % 443999; } 
-static uint32_t adiv_mod_20(uint32_t dividend) { return dividend % 854807; } 
-static uint32_t adiv_mod_21(uint32_t dividend) { return dividend % 1808243; } 
-static uint32_t adiv_mod_22(uint32_t dividend) { return dividend % 3973787; } 
-static uint32_t adiv_mod_23(uint32_t dividend) { return dividend % 7759439; } 
-static uint32_t adiv_mod_24(uint32_t dividend) { return dividend % 16669799; } 
-static uint32_t adiv_mod_25(uint32_t dividend) { return dividend % 28668287; } 
-static uint32_t adiv_mod_26(uint32_t dividend) { return dividend % 62923067; } 
-static uint32_t adiv_mod_27(uint32_t dividend) { return dividend % 118960319; } 
-static uint32_t adiv_mod_28(uint32_t dividend) { return dividend % 230959907; } 
-static uint32_t adiv_mod_29(uint32_t dividend) { return dividend % 408026687; } 
-static uint32_t adiv_mod_30(uint32_t dividend) { return dividend % 994046939; } 
-static uint32_t adiv_mod_31(uint32_t dividend) { return dividend % 2139408407; } 
-adiv_fptr const adiv_funcs[] = {
-    adiv_mod_0,
-    adiv_mod_0,
-    adiv_mod_2,
-    adiv_mod_3,
-    adiv_mod_4,
-    adiv_mod_5,
-    adiv_mod_6,
-    adiv_mod_7,
-    adiv_mod_8,
-    adiv_mod_9,
-    adiv_mod_10,
-    adiv_mod_11,
-    adiv_mod_12,
-    adiv_mod_13,
-    adiv_mod_14,
-    adiv_mod_15,
-    adiv_mod_16,
-    adiv_mod_17,
-    adiv_mod_18,
-    adiv_mod_19,
-    adiv_mod_20,
-    adiv_mod_21,
-    adiv_mod_22,
-    adiv_mod_23,
-    adiv_mod_24,
-    adiv_mod_25,
-    adiv_mod_26,
-    adiv_mod_27,
-    adiv_mod_28,
-    adiv_mod_29,
-    adiv_mod_30,
-    adiv_mod_31,
-    adiv_mod_0,
-};
 
 #endif /*ADIV_H*/
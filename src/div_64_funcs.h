@@ -0,0 +1,172 @@
+/*
+ * This file is generated by the tool gen_primes.py
+ * the file itself is under the public domain
+ */
+#ifndef ADIV64_H
+#define ADIV64_H
+#include <stdint.h>
+
+static const uint64_t adiv64_n_values = 64;
+static const uint64_t adiv64_values[] = {
+    0LLU, 0LLU, 2LLU, 7LLU, 13LLU, 23LLU, 61LLU, 103LLU, 251LLU, 467LLU, 839LLU, 
+    1619LLU, 3623LLU, 8147LLU, 13523LLU, 27527LLU, 58727LLU, 117959LLU, 262127LLU, 
+    452759LLU, 1037087LLU, 2024063LLU, 3792827LLU, 7596299LLU, 15262763LLU, 29550959LLU, 
+    63627527LLU, 116452067LLU, 202002887LLU, 479219627LLU, 872382383LLU, 1961851847LLU, 
+    4040610059LLU, 8283358739LLU, 13695608999LLU, 30693460079LLU, 66579798743LLU, 
+    113475537347LLU, 230151374507LLU, 487808392187LLU, 881432125643LLU, 2165393924543LLU, 
+    3734035123727LLU, 7453763553767LLU, 15244859875703LLU, 32381311406987LLU, 67013724725147LLU, 
+    119975059400387LLU, 263019861469439LLU, 553255334541683LLU, 974147307734663LLU, 
+    2158576180237403LLU, 3711085702704467LLU, 8038980763039043LLU, 17851618245945767LLU, 
+    30189926702603939LLU, 61446061314693347LLU, 142786982843157923LLU, 254448242013588443LLU, 
+    487541408795523023LLU, 981554486961623507LLU, 1938878309164299443LLU, 3944839149070011047LLU, 
+    7417515124047663143LLU
+};
+static const uint64_t adiv64_magic_hi[] = {
+    0x0000000000000000LLU,
+    0x0000000000000000LLU,
+    0x8000000000000000LLU,
+    0x2492492492492492LLU,
+    0x13B13B13B13B13B1LLU,
+    0x0B21642C8590B216LLU,
+    0x04325C53EF368EB0LLU,
+    0x027C45979C95204FLLU,
+    0x0105197F7D734041LLU,
+    0x008C55841C815ED5LLU,
+    0x004E1CAE8815F811LLU,
+    0x00287AB3F173E755LLU,
+    0x001216C09E471568LLU,
+    0x00080B4FE85EC545LLU,
+    0x0004D8A49F17FC36LLU,
+    0x0002617B7038FD7ALLU,
+    0x00011DAE752A52B1LLU,
+    0x00008E3AADD98584LLU,
+    0x0000400110048413LLU,
+    0x0000250E35F426F2LLU,
+    0x0000102D6046DCC3LLU,
+    0x00000849F40FCC95LLU,
+    0x0000046C64600D82LLU,
+    0x0000023567119431LLU,
+    0x0000011966D52100LLU,
+    0x00000091574ECD0ALLU,
+    0x0000004380707FE5LLU,
+    0x00000024E1C0B670LLU,
+    0x00000015430C905BLLU,
+    0x00000008F6611EA6LLU,
+    0x00000004EC5AEB01LLU,
+    0x0000000230721FF2LLU,
+    0x00000001101D8135LLU,
+    0x0000000084BCC73DLLU,
+    0x00000000504834B8LLU,
+    0x0000000023D28503LLU,
+    0x000000001083A222LLU,
+    0x0000000009B07D88LLU,
+    0x0000000004C6FFD4LLU,
+    0x0000000002410500LLU,
+    0x00000000013F5696LLU,
+    0x000000000081FCE6LLU,
+    0x00000000004B6183LLU,
+    0x000000000025C346LLU,
+    0x00000000001276AELLU,
+    0x000000000008B148LLU,
+    0x0000000000043344LLU,
+    0x000000000002589ALLU,
+    0x00000000000111F6LLU,
+    0x000000000000823ELLU,
+    0x00000000000049F8LLU,
+    0x0000000000002161LLU,
+    0x000000000000136ALLU,
+    0x00000000000008F6LLU,
+    0x0000000000000409LLU,
+    0x0000000000000263LLU,
+    0x000000000000012CLLU,
+    0x0000000000000081LLU,
+    0x0000000000000048LLU,
+    0x0000000000000025LLU,
+    0x0000000000000012LLU,
+    0x0000000000000009LLU,
+    0x0000000000000004LLU,
+    0x0000000000000002LLU,
+};
+static const uint64_t adiv64_magic_lo[] = {
+    0x0000000000000000LLU,
+    0x0000000000000000LLU,
+    0x0000000000000000LLU,
+    0x4924924924924925LLU,
+    0x3B13B13B13B13B14LLU,
+    0x42C8590B21642C86LLU,
+    0x4325C53EF368EB05LLU,
+    0x88B2F392A409F117LLU,
+    0x465FDF5CD0105198LLU,
+    0xCA47436D1679B229LLU,
+    0x16462DC4CE43BCE0LLU,
+    0x3A58DD5F081071DALLU,
+    0xEDFB56225731AC7BLLU,
+    0x699C8419C43BF450LLU,
+    0xBF63B542F53A7A1BLLU,
+    0xCE5433ABAAFF94DELLU,
+    0x71962233B0DAEF23LLU,
+    0x038CEEFF02193FA7LLU,
+    0x3151919AAAD155FALLU,
+    0xD3CDC4003387C308LLU,
+    0x9A6747507826021DLLU,
+    0xC6AD3FEBB4F1BA52LLU,
+    0x8D10DD431A97E1C8LLU,
+    0xC90F483D6D0D9741LLU,
+    0xE40AC25517CDCCEDLLU,
+    0x5C89D501EA52FFECLLU,
+    0xBE6FFDB8767B775BLLU,
+    0x56FF42870A760293LLU,
+    0x00151E17038411E6LLU,
+    0x89129267D26BEDC4LLU,
+    0x328E8D1508196102LLU,
+    0x0F57446627913B92LLU,
+    0x8E5FB0814B6B8884LLU,
+    0x4154CD4597CC82B2LLU,
+    0xE97D65215D4F8E62LLU,
+    0x5CA799BE7BF09381LLU,
+    0x5919071005BAE38ELLU,
+    0x5CFE28D660959111LLU,
+    0x0F3F71EB621C3150LLU,
+    0xEDB19499A077DA7FLLU,
+    0x60D764BEA69EA84DLLU,
+    0x0A19B54D221E30FFLLU,
+    0x834627B60D8669B9LLU,
+    0xCFB87B7A8303CD97LLU,
+    0x696DC915D9630CD6LLU,
+    0x8B7915E06F35C92ELLU,
+    0x2691704A1DB9B162LLU,
+    0xD2CC16EF7A6CC98CLLU,
+    0x6A3284D2C26B4811LLU,
+    0x3073617CACD44D31LLU,
+    0x4C61D973C994B578LLU,
+    0xCADF848ED2C15A3ALLU,
+    0xB6ACBB9043B846D2LLU,
+    0xA97C13AE06E4E3B1LLU,
+    0x565D3D150CCF0346LLU,
+    0x05ED13381E22D2B1LLU,
+    0x35DA07FD0C589443LLU,
+    0x30CEDFB25628B52FLLU,
+    0x7F3DEF4C74FDB7DELLU,
+    0xD61536422EFF01B0LLU,
+    0xCB1C209EF87D21D2LLU,
+    0x839E26D2E14F28B6LLU,
+    0xAD1991EAAF79F71DLLU,
+    0x7CA696CF5626C376LLU,
+};
+
+/*returns dividend % divisor, magic_hi/lo must be adiv64_magic_hi[i]/adiv64_magic_lo[i] where divisor is adiv64_values[i]*/
+static inline uint64_t adiv64_fastmod(uint64_t dividend, uint64_t magic_hi, uint64_t magic_lo, uint64_t divisor) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t lowbits = ((((__uint128_t) magic_hi) << 64) | magic_lo) * dividend;
+    /*high 128 bits of the 128x64 product, shifted down by 64*/
+    __uint128_t bottom_half = ((lowbits & 0xFFFFFFFFFFFFFFFFLLU) * divisor) >> 64;
+    __uint128_t top_half = (lowbits >> 64) * divisor;
+    return (uint64_t) ((bottom_half + top_half) >> 64);
+#else
+    (void) magic_hi;
+    (void) magic_lo;
+    return dividend % divisor;
+#endif
+}
+
+#endif /*ADIV64_H*/
@@ -38,6 +38,38 @@ needed functions that should be defined before including this:
     size_t hasht_hash(void *udata, hasht_key_type *key)
 
     udata is in struct hasht, you're supposed to set it directly when you initialize the hashtable
+
+    #if HASHT_PROBE is defined, keys can also be looked up by another type (hasht_find_as, hasht_remove_as)
+    without building a hasht_key_type, for example a (pointer, length) slice of a buffer for string keys
+    typedef <type> hasht_probe_type;
+    size_t hasht_probe_hash(hasht_probe_type *probe) (must equal hasht_hash() of the key the probe matches)
+    int    hasht_probe_eq_cmp(hasht_probe_type *probe, hasht_key_type *key) (returns 0 if equal)
+    (with HASHT_DATA_ARG both take void *udata first, same as above)
+
+    #if HASHT_STR_KEYS is defined, hasht_key_type must be const char * (null terminated strings)
+    the table copies the bytes of every key it stores into chunks it owns, right after the key's length and hash
+    (hasht_str_len() reads the length), so the caller's strings don't need to outlive the insert
+    and resizing never calls hasht_hash() again. Everything is freed at once by hasht_deinit(),
+    the bytes of removed keys stay in their chunk until then
+    #if HASHT_STR_VALUES is defined too, the values (char *, or NULL) are copied the same way, each time one is stored
+    #if HASHT_INLINE_KEYS is defined too, the first HASHT_INLINE_KEY_SZ bytes of every key are also kept in its pair,
+    keys shorter than that are compared bytewise in the pair (without calling hasht_key_eq_cmp() or reading the copy)
+
+    #if HASHT_SOA is defined, the values are kept in their own array (ht->values) instead of in the pairs,
+    so probing only strides over the flags and keys, and a value is only touched once its key is found
+    there is no pair->value then, the value of an iterator is *iter.value (which also works without HASHT_SOA)
+
+    #if HASHT_HUGE_PAGES is defined (POSIX only), the bucket arrays start on a cache line, and the ones of at least
+    HASHT_HUGE_PAGE_MIN bytes are mapped on their own with 2MB pages (explicit ones if the system has them reserved,
+    transparent huge pages otherwise), which saves most of the TLB misses of probing a big table.
+    When mapping fails they come from memfuncs.alloc like the smaller ones
+
+    #if HASHT_SNAPSHOT is defined (POSIX only), hasht_save() writes a table to a file and hasht_open_mapped() maps it back,
+    the buckets are used in place, so the keys and values must not be (or contain) pointers,
+    and hasht_hash() must give the same hashes in every process that opens the file
+
+    #if HASHT_STATS is defined, every table counts what its lookups, removes and resizes cost (struct hasht_stats),
+    hasht_get_stats() copies the counters out. Without it nothing is counted and nothing is added to struct hasht
 needed typedefs: 
      typedef <type> hasht_key_type; 
      typedef <type> hasht_value_type; 
@@ -61,16 +93,156 @@ needed typedefs:
 #include <stdlib.h> //malloc, free
 #include <stdbool.h> 
 #include <string.h> //memset, memcpy, ...
-#include "div_32_funcs.h" //divison functions
+#include <stdint.h>
+#include <limits.h> //LONG_MAX
+
+#if defined(HASHT_POW2)
+    //power of two sizes, the bucket is taken from the top bits of hash * 2^64/phi (fibonacci hashing)
+    //probing wraps around with a mask, and growth always doubles
+#elif defined(HASHT_64BIT)
+    //sizes beyond 2^31 buckets, and the bucket is computed from all 64 bits of the hash
+    #if LONG_MAX < INT64_MAX
+        #error "HASHT_64BIT requires long to be 64 bits"
+    #endif
+    #include "div_64_funcs.h" //divison functions
+    #define HASHT_ADIV_N_VALUES adiv64_n_values
+    #define HASHT_ADIV_VALUES   adiv64_values
+#else
+    #include "div_32_funcs.h" //divison functions
+    #define HASHT_ADIV_N_VALUES adiv_n_values
+    #define HASHT_ADIV_VALUES   adiv_values
+#endif
+
+#if defined(HASHT_ROBIN_HOOD) && defined(HASHT_CTRL_BYTES)
+    #error "HASHT_ROBIN_HOOD can't be combined with HASHT_CTRL_BYTES"
+#endif
+
+#ifdef HASHT_THREADS
+    //used by the bulk operations (hasht_build_from_arrays, resizing with resize_nthreads > 1) and the sharded front end (struct hasht_sharded)
+    //struct hasht itself is still not thread safe
+    #include <pthread.h>
+#endif
+
+#ifdef HASHT_SWMR
+    //one writer thread and any number of lock-free readers (struct hasht_swmr)
+    #include <stdatomic.h>
+    #ifdef HASHT_INCREMENTAL_RESIZE
+        #error "HASHT_SWMR can't be combined with HASHT_INCREMENTAL_RESIZE"
+    #endif
+#endif
+
+#if defined(HASHT_STR_VALUES) && !defined(HASHT_STR_KEYS)
+    #error "HASHT_STR_VALUES requires HASHT_STR_KEYS"
+#endif
+
+#ifdef HASHT_STR_KEYS
+    //size of the chunks that the strings are copied into, a longer string gets a chunk of its own
+    #ifndef HASHT_STR_CHUNK
+        #define HASHT_STR_CHUNK (64L * 1024)
+    #endif
+#endif
+
+#if defined(HASHT_INLINE_KEYS) && !defined(HASHT_STR_KEYS)
+    #error "HASHT_INLINE_KEYS requires HASHT_STR_KEYS"
+#endif
+
+#ifdef HASHT_INLINE_KEYS
+    //keys shorter than this are entirely in their pair, longer ones only their prefix
+    #ifndef HASHT_INLINE_KEY_SZ
+        #define HASHT_INLINE_KEY_SZ 16
+    #endif
+#endif
+
+#ifdef HASHT_SNAPSHOT
+    #ifdef HASHT_STR_KEYS
+        #error "HASHT_SNAPSHOT can't be combined with HASHT_STR_KEYS (the keys point into the table's chunks)"
+    #endif
+    #include <stddef.h> //offsetof
+    #include <unistd.h> //write, close
+    #include <fcntl.h> //open
+    #include <errno.h>
+    #include <sys/stat.h> //fstat
+    #include <sys/mman.h> //mmap
+#endif
+
+#ifdef __GLIBC__
+    #include <malloc.h> //malloc_trim
+#endif
+
+#ifdef HASHT_HUGE_PAGES
+    #include <sys/mman.h> //mmap, madvise
+    #ifndef HASHT_HUGE_PAGE_SZ
+        #define HASHT_HUGE_PAGE_SZ (2L * 1024 * 1024)
+    #endif
+    //smaller bucket arrays would waste most of their huge page
+    #ifndef HASHT_HUGE_PAGE_MIN
+        #define HASHT_HUGE_PAGE_MIN HASHT_HUGE_PAGE_SZ
+    #endif
+#endif
+
+#ifdef HASHT_STATS
+    #include <time.h> //clock_gettime
+    //probe lengths 1 to HASHT_STATS_PROBE_HIST - 1 get their own slot of the histogram, the last slot counts all longer ones
+    #ifndef HASHT_STATS_PROBE_HIST
+        #define HASHT_STATS_PROBE_HIST 16
+    #endif
+    #if defined(HASHT_THREADS) || defined(HASHT_SWMR)
+        //finds of the same table can run at once (read locks of struct hasht_sharded, the readers of struct hasht_swmr)
+        #define HASHT_STATS_ADD(st, field, n) ((void) __atomic_fetch_add(&(st)->field, (n), __ATOMIC_RELAXED))
+        #define HASHT_STATS_LOAD(st, field) __atomic_load_n(&(st)->field, __ATOMIC_RELAXED)
+    #else
+        #define HASHT_STATS_ADD(st, field, n) ((void) ((st)->field += (n)))
+        #define HASHT_STATS_LOAD(st, field) ((st)->field)
+    #endif
+#endif
+
+#ifdef HASHT_INCREMENTAL_RESIZE
+    //resizing keeps the old table alive, and each following insert/find/remove moves this many of its buckets over
+    #ifndef HASHT_INCREMENTAL_STEP
+        #define HASHT_INCREMENTAL_STEP 32
+    #endif
+    //the new buckets fill up over time, they're zeroed as they're first touched (see hasht_init_sz__())
+    #define HASHT_RESIZE_LAZY_ZERO true
+#else
+    #define HASHT_RESIZE_LAZY_ZERO false
+#endif
 
 
+#ifndef HASHT_POW2
 static int hasht_get_adiv_power_idx(size_t at_least) {
     //starts at 2
-    for (int i=2; i < (int)adiv_n_values; i++) {
-        if (adiv_values[i] >= at_least) 
+    for (int i=2; i < (int)HASHT_ADIV_N_VALUES; i++) {
+        if (HASHT_ADIV_VALUES[i] >= at_least) 
+            return i;
+    }
+    return -1; //error, must be handled
+}
+#endif // HASHT_POW2
+
+//returns nbuckets_po2 for the smallest size that has at least at_least buckets
+static int hasht_get_power_idx(size_t at_least) {
+#ifdef HASHT_POW2
+    //starts at 2, stops where nbuckets wouldn't fit in a long
+    for (int i=2; i < (int) (sizeof(long) * CHAR_BIT) - 1; i++) {
+        if (((size_t) 1 << i) >= at_least)
             return i;
     }
     return -1; //error, must be handled
+#else
+    return hasht_get_adiv_power_idx(at_least);
+#endif
+}
+
+//(n * mul) / div without overflowing, mul is expected to be small (a percentage or 100)
+//saturates at LONG_MAX if the result itself doesn't fit
+static long hasht_mul_div(long n, long mul, long div) {
+    if (mul == 0)
+        return 0;
+    if (div > LONG_MAX / mul)
+        return n / (div / mul); //approximation, only for huge divisors
+    if (n / div > LONG_MAX / mul)
+        return LONG_MAX;
+    return (n / div) * mul + ((n % div) * mul) / div;
 }
 
 //#define HASHT_DBG
@@ -86,22 +258,113 @@ static int hasht_get_adiv_power_idx(size_t at_least) {
     #define HASHT_ASSERT(cond, msg) 
 #endif
 
+#if defined(__GNUC__)
+    #define HASHT_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+    #define HASHT_PREFETCH(addr) ((void) (addr))
+#endif
+
+#ifndef HASHT_CACHE_LINE
+    #define HASHT_CACHE_LINE 64
+#endif
+
+//resizes of tables with at least this many elements use ht->resize_nthreads threads (if it's above 1)
+#ifndef HASHT_PARALLEL_RESIZE_MIN
+    #define HASHT_PARALLEL_RESIZE_MIN (1L << 16)
+#endif
+
+//how many keys the batched lookups hash and prefetch ahead before probing
+#ifndef HASHT_BATCH_WIDTH
+    #define HASHT_BATCH_WIDTH 16
+#endif
+
 //notice how logic is inverted? so we can memset with 0
 #define HASHT_VLT_IS_NOT_EMPTY      (1U << 1)
 #define HASHT_VLT_IS_DELETED        (1U << 2)
 #define HASHT_VLT_IS_CORRUPT        (1U << 3)
 //long is used for all lengths / sizes
 
+#ifdef HASHT_CTRL_BYTES
+//the flags and a 7 bit partial hash are kept in a separate array of control bytes, one per bucket
+//probing compares a whole group of control bytes at once, and only touches a pair when the partial hash matches
+//  0x00       empty (so memsetting with 0 still means empty)
+//  0x01       deleted
+//  1xxxxxxx   occupied, the lower 7 bits are the partial hash
+//the first group is mirrored after the last bucket, so that a group can be loaded starting at any index
+#define HASHT_CTRL_EMPTY    0x00U
+#define HASHT_CTRL_DELETED  0x01U
+#define HASHT_CTRL_OCCUPIED 0x80U
+
+#if defined(__AVX2__) && !defined(HASHT_NO_SIMD)
+    #include <immintrin.h>
+    #define HASHT_GROUP_WIDTH 32
+#elif (defined(__SSE2__) || defined(_M_X64)) && !defined(HASHT_NO_SIMD)
+    #include <emmintrin.h>
+    #define HASHT_GROUP_WIDTH 16
+#else
+    #define HASHT_GROUP_WIDTH 8 //portable fallback
+#endif
+
+//bit i is set if the i'th control byte in the group matched
+typedef uint32_t hasht_mask_type;
+
+static hasht_mask_type hasht_group_match(const unsigned char *group, unsigned char ctrl) {
+#if HASHT_GROUP_WIDTH == 32
+    __m256i grp = _mm256_loadu_si256((const __m256i *) group);
+    return (hasht_mask_type) _mm256_movemask_epi8(_mm256_cmpeq_epi8(grp, _mm256_set1_epi8((char) ctrl)));
+#elif HASHT_GROUP_WIDTH == 16
+    __m128i grp = _mm_loadu_si128((const __m128i *) group);
+    return (hasht_mask_type) _mm_movemask_epi8(_mm_cmpeq_epi8(grp, _mm_set1_epi8((char) ctrl)));
+#else
+    hasht_mask_type mask = 0;
+    for (int i=0; i<HASHT_GROUP_WIDTH; i++)
+        mask |= (hasht_mask_type) (group[i] == ctrl) << i;
+    return mask;
+#endif
+}
+//index of the lowest set bit, mask must not be zero
+static int hasht_mask_first(hasht_mask_type mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int n = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+static unsigned char hasht_hash_to_ctrl(size_t full_hash) {
+    return (unsigned char) (HASHT_CTRL_OCCUPIED | (full_hash & 0x7F));
+}
+#endif // HASHT_CTRL_BYTES
+
 
 struct hasht_pair_type {
+#ifndef HASHT_CTRL_BYTES
     //bits:
     //[0...8]  flags
     //[8..32]  partial hash
     unsigned int pair_data; //this is two parts: the flags, and the partial hash
+#endif
+#ifdef HASHT_ROBIN_HOOD
+    unsigned int probe_dist; //distance from the bucket the hash maps to, only meaningful when occupied
+#endif
+#ifdef HASHT_STORE_HASH
+    size_t hash; //the full hash of key, so that resizing never calls hasht_hash()
+#endif
+#ifdef HASHT_INLINE_KEYS
+    char key_inline[HASHT_INLINE_KEY_SZ]; //strncpy() of key, zero padded (not terminated if the key is longer)
+#endif
     hasht_key_type   key;
+#ifndef HASHT_SOA
     hasht_value_type value;
+#endif
 };
 
+#ifndef HASHT_CTRL_BYTES
+
 //pair type functions
 static unsigned char hasht_pr_flags(struct hasht_pair_type *prt) {
     return prt->pair_data & 0xFF;
@@ -132,23 +395,39 @@ static void hasht_pr_set_flags(struct hasht_pair_type *prt, unsigned char flags)
 //     1            0          invalid state
 //     1            1          deleted
 
+//the flags of a bucket, as returned by hasht_pr_flags()
+//a lookup reads them once and tests that copy, with HASHT_SWMR the writer can change the bucket between two reads
+static bool hasht_flags_is_empty(unsigned char flags) {
+    return (! (flags & HASHT_VLT_IS_NOT_EMPTY)); //false mean occupied or deleted
+}
+static bool hasht_flags_is_corrupt(unsigned char flags) {
+    const unsigned char deleted_and_empty_mask = (HASHT_VLT_IS_DELETED | HASHT_VLT_IS_NOT_EMPTY);
+    const unsigned char deleted_and_empty      = (HASHT_VLT_IS_DELETED | 0); //invalid state
+    return   (flags & HASHT_VLT_IS_CORRUPT) ||
+             ((flags & deleted_and_empty_mask) == deleted_and_empty);
+}
+static bool hasht_flags_is_deleted(unsigned char flags) {
+    return   (flags & HASHT_VLT_IS_DELETED); //false means occupied or empty
+}
+static bool hasht_flags_is_occupied(unsigned char flags) {
+    //occupied here means an active bucket that contains a value
+    HASHT_ASSERT(!hasht_flags_is_corrupt(flags), "corrupt element found");
+    return !hasht_flags_is_empty(flags) && !hasht_flags_is_deleted(flags);
+}
+
 static bool hasht_pr_is_empty(struct hasht_pair_type *prt) {
-    return (! (hasht_pr_flags(prt) & HASHT_VLT_IS_NOT_EMPTY)); //false mean occupied or deleted
+    return hasht_flags_is_empty(hasht_pr_flags(prt));
 }
 static bool hasht_pr_is_corrupt(struct hasht_pair_type *prt) {
-    const unsigned char deleted_and_empty_mask = (HASHT_VLT_IS_DELETED | HASHT_VLT_IS_NOT_EMPTY); 
-    const unsigned char deleted_and_empty      = (HASHT_VLT_IS_DELETED | 0); //invalid state
-    return   (hasht_pr_flags(prt) & HASHT_VLT_IS_CORRUPT) || 
-             ((hasht_pr_flags(prt) & deleted_and_empty_mask) == deleted_and_empty);
+    return hasht_flags_is_corrupt(hasht_pr_flags(prt));
 }
 static bool hasht_pr_is_deleted(struct hasht_pair_type *prt) {
-    return   (hasht_pr_flags(prt) & HASHT_VLT_IS_DELETED); //false means occupied or empty
+    return hasht_flags_is_deleted(hasht_pr_flags(prt));
 }
 static bool hasht_pr_is_occupied(struct hasht_pair_type *prt) {
-    //occupied here means an active bucket that contains a value
-    HASHT_ASSERT(!hasht_pr_is_corrupt(prt), "corrupt element found");
-    return !hasht_pr_is_empty(prt) && !hasht_pr_is_deleted(prt); 
+    return hasht_flags_is_occupied(hasht_pr_flags(prt));
 }
+#endif // !HASHT_CTRL_BYTES
 
 typedef void * (*hasht_malloc_fptr)(size_t sz, void *userdata);
 typedef void * (*hasht_realloc_fptr)(void *ptr, size_t sz, void *userdata);
@@ -158,6 +437,11 @@ struct hasht_alloc_funcs {
     hasht_malloc_fptr alloc;
     hasht_realloc_fptr realloc;
     hasht_free_fptr free;
+    //optional, memory that reads as zero (freed with free), for the buckets: all zero is an empty table,
+    //so they don't need to be cleared (calloc and fresh mmap pages are only zeroed by the os once they're touched)
+    //it's calloc when alloc is the default malloc, otherwise NULL unless it's set after init
+    //(resizes that copy everything at once don't use it, see hasht_init_sz__())
+    hasht_malloc_fptr zalloc;
 };
 static void *hasht_def_malloc(size_t sz, void *unused_userdata_) {
     (void) unused_userdata_;
@@ -171,16 +455,23 @@ static void  hasht_def_free(void *ptr, void *unused_userdata_) {
     (void) unused_userdata_;
     free(ptr); 
 }
+static void *hasht_def_zalloc(size_t sz, void *unused_userdata_) {
+    (void) unused_userdata_;
+    return calloc(1, sz);
+}
 
 enum HASHT_ERR {
     HASHT_OK,
     HASHT_ALLOC_ERR,
     HASHT_INVALID_REQ_SZ,
     HASHT_FAILED_AT_RESIZE,
+    HASHT_IO_ERR, //reading or writing a snapshot failed (errno tells why)
+    HASHT_BAD_SNAPSHOT, //not a snapshot, corrupt, or written with another layout (other modes or types)
 
     HASHT_NOT_FOUND = -1, 
     HASHT_DUPLICATE_KEY = -2,
-    //the table refused to change the size, becuase it thinks it's smart and there's no need, this can be forced though (WIP)
+    //the table refused to change the size, becuase it thinks it's smart and there's no need, this can be forced though
+    //(see hasht_rehash(), hasht_shrink_to_fit())
     HASHT_RESIZE_REFUSE = -3, 
     HASHT_ITER_STOP = -4,
     HASHT_ITER_FIRST = -5,
@@ -188,10 +479,77 @@ enum HASHT_ERR {
     HASHT_INVALID_TABLE_STATE = -6, //non recoverable, the only safe operation to do is to call deinit
 };
 
-//Careful with changes!, the struct is migrated to a new one in hasht_resize__
+#ifdef HASHT_STR_KEYS
+//every stored string is laid out as [struct hasht_str_hdr__][bytes][\0], aligned to size_t
+struct hasht_str_hdr__ {
+    size_t hash; //hash of the key, 0 for values
+    size_t len;
+};
+struct hasht_str_chunk__ {
+    struct hasht_str_chunk__ *next;
+};
+struct hasht_str_arena__ {
+    struct hasht_str_chunk__ *chunks; //newest first
+    char *cur; //free space of the newest chunk
+    char *end;
+};
+#endif
+
+#ifdef HASHT_STATS
+//everything counts up from hasht_init(), and is kept across resizes
+struct hasht_stats {
+    //hasht_find(), hasht_find_as(), hasht_find_batch() and the finds of struct hasht_sharded and struct hasht_swmr
+    long finds;
+    long hits;
+    long misses;
+    //every lookup in the buckets (the ones of inserts and removes too), by how many buckets it looked at
+    //(groups of HASHT_GROUP_WIDTH with HASHT_CTRL_BYTES), probe_len_hist[0] is the ones that looked at a single one
+    long probe_len_hist[HASHT_STATS_PROBE_HIST];
+    //keys that were compared because the fingerprint matched (partial hash, control byte, or stored hash), but were different
+    //more than a few per lookup means hasht_hash() has too few distinct bits
+    long fingerprint_false_positives;
+    long tombstones_created; //removes that left a deleted bucket behind
+    long tombstones_reused; //inserts into a deleted bucket
+    long tombstones_reclaimed; //deleted buckets emptied right away by a remove next to them (HASHT_AGRESSIVE_CLEANUP)
+    long tombstones_purged; //deleted buckets emptied by hasht_purge_deleted()
+    long resizes;
+    long resize_bytes; //size of the bucket arrays allocated by resizes
+    //time spent allocating the new buckets and moving the pairs, with HASHT_INCREMENTAL_RESIZE only the allocation
+    //is counted, the moving is spread over the following operations
+    long resize_ns;
+};
+//what one lookup in the buckets found out, see hasht_probe_pos__()
+struct hasht_probe_count__ {
+    long nprobed;
+    long nfalse;
+};
+#endif
+
+#ifdef HASHT_HUGE_PAGES
+//how a bucket array was allocated (see hasht_bkt_alloc__())
+struct hasht_bkt_mem__ {
+    void *base; //the array starts at the first cache line boundary in it
+    size_t mapped_sz; //0 if it came from memfuncs.alloc
+};
+#endif
+
+//Careful with changes!, the struct is migrated to a new one in hasht_resize__ (hasht_migrate_to__)
 struct hasht {
     struct hasht_pair_type *tab;
-    adiv_fptr div_func; //a pointer to a function that does fast division
+#ifdef HASHT_SOA
+    hasht_value_type *values; //nbuckets values, values[i] belongs to tab[i]
+#endif
+#ifdef HASHT_CTRL_BYTES
+    unsigned char *ctrl; //nbuckets + HASHT_GROUP_WIDTH bytes, allocated with tab (right after the pairs)
+#endif
+#if defined(HASHT_POW2)
+    //nbuckets == 1 << nbuckets_po2, nothing else needed
+#elif defined(HASHT_64BIT)
+    uint64_t div_magic_hi; //precomputed 128 bit constant for the fast modulo by nbuckets (adiv64_fastmod)
+    uint64_t div_magic_lo;
+#else
+    uint64_t div_magic; //precomputed constant for the fast modulo by nbuckets (adiv_fastmod)
+#endif
 
     long nelements; //number of active buckets (ones that are not empty, and not deleted)
     long ndeleted;
@@ -199,13 +557,88 @@ struct hasht {
     long nbuckets_po2; //power of two
     long grow_at_gt_n;  //saved result of computation
     long shrink_at_lt_n; 
+    long purge_at_deleted_n; //deleted buckets are cleared out in place once ndeleted reaches this
     long grow_at_percentage; // (divide by 100, for example 0.50 is 50)
     long shrink_at_percentage; 
+    long min_nbuckets; //it never shrinks below this on its own: the size it was created with, or the last hasht_reserve()/hasht_rehash()
+    long resize_nthreads; //threads used to move the pairs when resizing big tables, 1 by default (see HASHT_PARALLEL_RESIZE_MIN)
     struct hasht_alloc_funcs memfuncs;
     void *userdata;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    //while a resize is in progress: the table being emptied into this one, NULL otherwise
+    //nelements above counts the elements of both tables
+    struct hasht *old;
+    long migrate_idx; //next bucket of old to move
+#endif
+#ifdef HASHT_STR_KEYS
+    //where the strings are copied, NULL in the new table of a resize until it takes over (so moving pairs never copies them again)
+    struct hasht_str_arena__ *strs;
+#endif
+#ifdef HASHT_HUGE_PAGES
+    struct hasht_bkt_mem__ tab_mem;
+#ifdef HASHT_SOA
+    struct hasht_bkt_mem__ values_mem;
+#endif
+#endif
+#ifdef HASHT_SNAPSHOT
+    //the file mapping that tab (and values) point into, NULL when they come from memfuncs (see hasht_open_mapped())
+    void *mapping;
+    size_t mapping_sz;
+#endif
+#ifdef HASHT_STATS
+    struct hasht_stats stats; //last, so it doesn't push apart the fields that probing reads
+#endif
 
 };
 
+//bucket state by index, the rest of the table goes through these so that the flags
+//can live either in pair_data or in the control bytes (HASHT_CTRL_BYTES)
+#ifdef HASHT_CTRL_BYTES
+static bool hasht_bkt_is_empty(struct hasht *ht, long idx) {
+    return ht->ctrl[idx] == HASHT_CTRL_EMPTY;
+}
+static bool hasht_bkt_is_deleted(struct hasht *ht, long idx) {
+    return ht->ctrl[idx] == HASHT_CTRL_DELETED;
+}
+static bool hasht_bkt_is_corrupt(struct hasht *ht, long idx) {
+    unsigned char ctrl = ht->ctrl[idx];
+    return !(ctrl & HASHT_CTRL_OCCUPIED) && ctrl != HASHT_CTRL_EMPTY && ctrl != HASHT_CTRL_DELETED;
+}
+static bool hasht_bkt_is_occupied(struct hasht *ht, long idx) {
+    HASHT_ASSERT(!hasht_bkt_is_corrupt(ht, idx), "corrupt element found");
+    return ht->ctrl[idx] & HASHT_CTRL_OCCUPIED;
+}
+//keeps the mirrored copy of the first group in sync
+static void hasht_bkt_set_ctrl(struct hasht *ht, long idx, unsigned char ctrl) {
+    ht->ctrl[idx] = ctrl;
+    //only loops more than once for tables smaller than a group
+    for (long mirror = idx + ht->nbuckets; mirror < ht->nbuckets + HASHT_GROUP_WIDTH; mirror += ht->nbuckets)
+        ht->ctrl[mirror] = ctrl;
+}
+#else
+static bool hasht_bkt_is_empty(struct hasht *ht, long idx) {
+    return hasht_pr_is_empty(ht->tab + idx);
+}
+static bool hasht_bkt_is_deleted(struct hasht *ht, long idx) {
+    return hasht_pr_is_deleted(ht->tab + idx);
+}
+static bool hasht_bkt_is_corrupt(struct hasht *ht, long idx) {
+    return hasht_pr_is_corrupt(ht->tab + idx);
+}
+static bool hasht_bkt_is_occupied(struct hasht *ht, long idx) {
+    return hasht_pr_is_occupied(ht->tab + idx);
+}
+#endif // HASHT_CTRL_BYTES
+
+//the value of the pair in bucket idx
+static hasht_value_type *hasht_value_at__(struct hasht *ht, long idx) {
+#ifdef HASHT_SOA
+    return ht->values + idx;
+#else
+    return &ht->tab[idx].value;
+#endif
+}
+
 
 //shrink at, grow at are percentages [0, 99] inclusive, they must fulfil (grow_at / shrink_at) > 2.0
 //the function can fail
@@ -233,9 +666,12 @@ static int hasht_set_parameters(struct hasht *ht, long shrink_at, long grow_at)
     int rv = hasht_init_parameters(ht, shrink_at, grow_at);
     if (rv != HASHT_OK)
         return rv;
-    //this can potentially overflow, maybe we should cast to size_t
-    ht->grow_at_gt_n = (ht->nbuckets * ht->grow_at_percentage) / 100;
-    ht->shrink_at_lt_n = (ht->nbuckets * ht->shrink_at_percentage) / 100;
+    ht->grow_at_gt_n = hasht_mul_div(ht->nbuckets, ht->grow_at_percentage, 100);
+    ht->shrink_at_lt_n = hasht_mul_div(ht->nbuckets, ht->shrink_at_percentage, 100);
+    //half of what's left above the growth threshold, so at least that much stays empty
+    ht->purge_at_deleted_n = hasht_mul_div(ht->nbuckets, (100 - ht->grow_at_percentage) / 2, 100);
+    if (ht->purge_at_deleted_n < 1)
+        ht->purge_at_deleted_n = 1;
     return rv;
 }
 
@@ -251,21 +687,21 @@ static long hasht_calc_nelements_to_nbuckets(long needed_nelements, long shrink_
     //x = needed_nelements * 100 / some_integer
     long r1i = (shrink_at_percentage + grow_at_percentage) / 2;
     r1i = r1i <= 0 ? 1 : r1i;
-    long needed_nbuckets_opt_big = (needed_nelements * 100) / r1i;
+    long needed_nbuckets_opt_big = hasht_mul_div(needed_nelements, 100, r1i);
     r1i = grow_at_percentage - (grow_at_percentage - shrink_at_percentage) / 3;
     long needed_nbuckets_opt_small = needed_nbuckets_opt_big;
     if (r1i > 0) 
-        needed_nbuckets_opt_small = (needed_nelements * 100) / r1i;
+        needed_nbuckets_opt_small = hasht_mul_div(needed_nelements, 100, r1i);
 
     long needed_nbuckets = needed_nbuckets_opt_big;
 
     if (needed_nbuckets > HASHT_MIN_TABLESIZE) {
 #ifdef HASHT_DBG
-        long ratio_test       = ((needed_nelements * 100) / needed_nbuckets);
+        long ratio_test       = hasht_mul_div(needed_nelements, 100, needed_nbuckets);
         HASHT_ASSERT( ratio_test >= shrink_at_percentage, "ratio calculation failed");
         HASHT_ASSERT( ratio_test <= grow_at_percentage, "ratio calculation failed");
 #endif
-        long ratio_test_small = ((needed_nelements * 100) / needed_nbuckets_opt_small);
+        long ratio_test_small = hasht_mul_div(needed_nelements, 100, needed_nbuckets_opt_small);
         if (ratio_test_small > shrink_at_percentage)
             needed_nbuckets = needed_nbuckets_opt_small;
     }
@@ -277,25 +713,63 @@ static long hasht_calc_nelements_to_nbuckets(long needed_nelements, long shrink_
     return needed_nbuckets;
 }
 
+#if !defined(HASHT_64BIT) && !defined(HASHT_POW2)
+//the 32 bit modulo only takes 32 bits of the hash, fold the upper half in instead of dropping it
+static uint32_t hasht_fold_hash32(size_t full_hash) {
+#if SIZE_MAX > 0xFFFFFFFFU
+    return (uint32_t) (full_hash ^ (full_hash >> 32));
+#else
+    return (uint32_t) full_hash;
+#endif
+}
+#endif
+
+static long hasht_integer_mod_buckets(struct hasht *ht, size_t full_hash) {
+#if defined(HASHT_POW2)
+    //fibonacci hashing: the top bits of the product are well mixed even when the low bits of the hash aren't
+    long divd_hash = (long) (((uint64_t) full_hash * 0x9E3779B97F4A7C15LLU) >> (64 - ht->nbuckets_po2));
+#elif defined(HASHT_64BIT)
+    //fast division (% not division) by hardcoded primes
+    long divd_hash = adiv64_fastmod(full_hash, ht->div_magic_hi, ht->div_magic_lo, ht->nbuckets);
+#else
+    long divd_hash = adiv_fastmod(hasht_fold_hash32(full_hash), ht->div_magic, ht->nbuckets);
+#endif
+    HASHT_ASSERT(divd_hash < ht->nbuckets, "");
+    return divd_hash;
+}
+
 //this is not very trivial, multiple fields are tied to each other and they need to be consistent
 //if this fails it doesnt change the field
 static int hasht_change_sz_field(struct hasht *ht, long nbuckets, bool force) {
     (void) force;
     //ignore values that are too small
     nbuckets = nbuckets < HASHT_MIN_TABLESIZE ? HASHT_MIN_TABLESIZE : nbuckets;
-    long nbuckets_po2 = hasht_get_adiv_power_idx(nbuckets);
+    long nbuckets_po2 = hasht_get_power_idx(nbuckets);
     if (nbuckets_po2 < 0)
         return HASHT_INVALID_REQ_SZ; //too big
-    HASHT_ASSERT(nbuckets_po2 >= 2 && nbuckets_po2 < adiv_n_values, "adiv failed");
-    long nbuckets_prime = adiv_values[nbuckets_po2];
+#ifdef HASHT_POW2
+    long nbuckets_prime = 1L << nbuckets_po2; //not a prime in this mode
+#else
+    HASHT_ASSERT(nbuckets_po2 >= 2 && nbuckets_po2 < (long) HASHT_ADIV_N_VALUES, "adiv failed");
+    long nbuckets_prime = HASHT_ADIV_VALUES[nbuckets_po2];
+#endif
+    if ((size_t) nbuckets_prime > (SIZE_MAX / 2) / sizeof(struct hasht_pair_type))
+        return HASHT_INVALID_REQ_SZ; //the size of the allocation would overflow
     ht->nbuckets     = nbuckets_prime;
     ht->nbuckets_po2 = nbuckets_po2;
-    ht->div_func = adiv_funcs[ht->nbuckets_po2];
-    HASHT_ASSERT(ht->div_func, "invalid adiv fptr");
+#if defined(HASHT_POW2)
+#elif defined(HASHT_64BIT)
+    ht->div_magic_hi = adiv64_magic_hi[ht->nbuckets_po2];
+    ht->div_magic_lo = adiv64_magic_lo[ht->nbuckets_po2];
+    HASHT_ASSERT(ht->div_magic_hi || ht->div_magic_lo, "invalid adiv magic");
+#else
+    ht->div_magic = adiv_magic[ht->nbuckets_po2];
+    HASHT_ASSERT(ht->div_magic, "invalid adiv magic");
+#endif
 
-#ifdef HASHT_DBG
+#if defined(HASHT_DBG) && !defined(HASHT_POW2)
     long rnd = rand();
-    HASHT_ASSERT(ht->div_func(rnd) == rnd % ht->nbuckets, "adiv failed");
+    HASHT_ASSERT(hasht_integer_mod_buckets(ht, rnd) == rnd % ht->nbuckets, "adiv failed");
 #endif// HASHT_DBG
     
     HASHT_ASSERT(ht->shrink_at_percentage > 0 && ht->grow_at_percentage > ht->shrink_at_percentage, "invalid growth parameters");
@@ -306,7 +780,13 @@ static int hasht_change_sz_field(struct hasht *ht, long nbuckets, bool force) {
 static void hasht_zero_sz_field(struct hasht *ht) {
     ht->nbuckets = 0;
     ht->nbuckets_po2 = 0;
-    ht->div_func = NULL;
+#if defined(HASHT_POW2)
+#elif defined(HASHT_64BIT)
+    ht->div_magic_hi = 0;
+    ht->div_magic_lo = 0;
+#else
+    ht->div_magic = 0;
+#endif
 }
 
 //tries to find memory corruption
@@ -315,17 +795,17 @@ static void hasht_zero_sz_field(struct hasht *ht) {
 //for example hasht_dbg_check(ht, 0, ht->nbuckets, 0, 0, -1) -> fail if any are corrupt
 static bool hasht_dbg_check(struct hasht *ht, long beg_idx, long end_idx, int query_empty, int query_deleted, int query_corrupt) {
     long len = end_idx - beg_idx;
-    for (int i=0; i<len; i++) {
-        struct hasht_pair_type *pair = ht->tab + i + beg_idx;
+    for (long i=0; i<len; i++) {
+        long idx = i + beg_idx;
         int expect[3] = {
             query_empty,
             query_deleted,
             query_corrupt, 
         };
         int found[3] = { 
-            hasht_pr_is_empty(pair),
-            hasht_pr_is_deleted(pair),
-            hasht_pr_is_corrupt(pair),
+            hasht_bkt_is_empty(ht, idx),
+            hasht_bkt_is_deleted(ht, idx),
+            hasht_bkt_is_corrupt(ht, idx),
         };
         for (int i=0; i<3; i++) {
             if (((expect[i] > 0) && !found[i]) || ((expect[i] < 0) && found[i]))
@@ -338,26 +818,187 @@ static bool hasht_dbg_check(struct hasht *ht, long beg_idx, long end_idx, int qu
 static bool hasht_dbg_sanity_01(struct hasht *ht) {
     return ht->tab &&
            ht->nbuckets &&
-           (ht->nbuckets_po2 == hasht_get_adiv_power_idx(ht->nbuckets)) &&
+           (ht->nbuckets_po2 == hasht_get_power_idx(ht->nbuckets)) &&
            (ht->shrink_at_lt_n < ht->grow_at_gt_n) &&
-           ht->div_func;
+#ifdef HASHT_POW2
+           (ht->nbuckets == (1L << ht->nbuckets_po2));
+#else
+           hasht_integer_mod_buckets(ht, ht->nbuckets) == 0;
+#endif
+}
+#ifdef HASHT_ROBIN_HOOD
+//no deleted buckets, and an entry is never more than one step further from home than the one before it
+static bool hasht_dbg_check_robin_hood(struct hasht *ht) {
+    for (long idx=0; idx<ht->nbuckets; idx++) {
+        struct hasht_pair_type *pair = ht->tab + idx;
+        struct hasht_pair_type *prev = ht->tab + (idx ? idx - 1 : ht->nbuckets - 1);
+        if (hasht_pr_is_deleted(pair))
+            return false;
+        if (hasht_pr_is_empty(pair))
+            continue;
+        if (pair->probe_dist > 0 && (hasht_pr_is_empty(prev) || prev->probe_dist + 1 < pair->probe_dist))
+            return false;
+    }
+    return ht->ndeleted == 0;
 }
+#endif
 static bool hasht_dbg_sanity_heavy(struct hasht *ht) {
+#ifdef HASHT_ROBIN_HOOD
+    if (!hasht_dbg_check_robin_hood(ht))
+        return false;
+#endif
     return hasht_dbg_sanity_01(ht) && hasht_dbg_check(ht, 0, ht->nbuckets, 0, 0, -1);
 }
 
 static void hasht_memset(struct hasht *ht, long begin_inc, long end_exc) {
     HASHT_ASSERT(hasht_dbg_sanity_01(ht), "hasht corrupt or not initialized");
     //the flags are designed so that memsetting with 0 means: empty, not deleted, not corrupt
+#ifdef HASHT_CTRL_BYTES
+    //the pairs themselves are never read unless their control byte says they're occupied
+    memset(ht->ctrl + begin_inc, 0, end_exc - begin_inc);
+    for (long mirror = ht->nbuckets; mirror < ht->nbuckets + HASHT_GROUP_WIDTH; mirror++)
+        ht->ctrl[mirror] = ht->ctrl[(mirror - ht->nbuckets) % ht->nbuckets];
+#else
     memset(ht->tab + begin_inc, 0, sizeof(struct hasht_pair_type) * (end_exc - begin_inc));
+#endif
     HASHT_ASSERT(hasht_dbg_check(ht, begin_inc, end_exc, 1, -1, -1), "");
 }
 
-static int hasht_init_ex(struct hasht *ht,
+//size of the single allocation that holds the buckets of a table
+static size_t hasht_tab_alloc_sz(long nbuckets) {
+    size_t sz = sizeof(struct hasht_pair_type) * nbuckets;
+#ifdef HASHT_CTRL_BYTES
+    sz += nbuckets + HASHT_GROUP_WIDTH;
+#endif
+    return sz;
+}
+
+#ifdef HASHT_HUGE_PAGES
+//a bucket array of sz bytes that starts on a cache line, NULL if there's no memory
+//*zeroed asks for memory that reads as zero, and is set to whether it does
+static void *hasht_bkt_alloc__(struct hasht *ht, size_t sz, struct hasht_bkt_mem__ *mem, bool *zeroed) {
+    if (sz >= HASHT_HUGE_PAGE_MIN) {
+        size_t mapped_sz = (sz + HASHT_HUGE_PAGE_SZ - 1) / HASHT_HUGE_PAGE_SZ * HASHT_HUGE_PAGE_SZ;
+        void *base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        //only succeeds if huge pages were reserved (vm.nr_hugepages)
+        base = mmap(NULL, mapped_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (base == MAP_FAILED) {
+            base = mmap(NULL, mapped_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            //a hint, it fails harmlessly where transparent huge pages are off
+            if (base != MAP_FAILED)
+                madvise(base, mapped_sz, MADV_HUGEPAGE);
+#endif
+        }
+        if (base != MAP_FAILED) {
+            mem->base = base;
+            mem->mapped_sz = mapped_sz;
+            *zeroed = true; //fresh anonymous pages always are
+            return base;
+        }
+    }
+    if (*zeroed && ht->memfuncs.zalloc)
+        mem->base = ht->memfuncs.zalloc(sz + HASHT_CACHE_LINE - 1, ht->userdata);
+    else
+        mem->base = ht->memfuncs.alloc(sz + HASHT_CACHE_LINE - 1, ht->userdata);
+    *zeroed = *zeroed && ht->memfuncs.zalloc;
+    mem->mapped_sz = 0;
+    if (!mem->base)
+        return NULL;
+    return (void *) (((uintptr_t) mem->base + HASHT_CACHE_LINE - 1) & ~((uintptr_t) HASHT_CACHE_LINE - 1));
+}
+static void hasht_bkt_free__(struct hasht *ht, struct hasht_bkt_mem__ *mem) {
+    if (mem->mapped_sz)
+        munmap(mem->base, mem->mapped_sz);
+    else
+        ht->memfuncs.free(mem->base, ht->userdata);
+    mem->base = NULL;
+    mem->mapped_sz = 0;
+}
+#endif // HASHT_HUGE_PAGES
+
+#ifdef HASHT_STR_KEYS
+static void hasht_deinit(struct hasht *ht);
+
+static struct hasht_str_hdr__ *hasht_str_hdr__(const char *str) {
+    return (struct hasht_str_hdr__ *) str - 1;
+}
+//length of a string that the table stored (a key, or a value with HASHT_STR_VALUES)
+static size_t hasht_str_len(const char *str) {
+    return hasht_str_hdr__(str)->len;
+}
+static int hasht_str_arena_init__(struct hasht *ht) {
+    ht->strs = ht->memfuncs.alloc(sizeof *ht->strs, ht->userdata);
+    if (!ht->strs)
+        return HASHT_ALLOC_ERR;
+    memset(ht->strs, 0, sizeof *ht->strs);
+    return HASHT_OK;
+}
+static void hasht_str_arena_deinit__(struct hasht *ht) {
+    if (!ht->strs)
+        return;
+    struct hasht_str_chunk__ *chunk = ht->strs->chunks;
+    while (chunk) {
+        struct hasht_str_chunk__ *next = chunk->next;
+        ht->memfuncs.free(chunk, ht->userdata);
+        chunk = next;
+    }
+    ht->memfuncs.free(ht->strs, ht->userdata);
+    ht->strs = NULL;
+}
+//the pairs of from are now in to, the strings they point to go with them
+static void hasht_str_arena_move__(struct hasht *to, struct hasht *from) {
+    HASHT_ASSERT(!to->strs, "");
+    to->strs = from->strs;
+    from->strs = NULL;
+}
+//copies str into the arena, NULL if allocating a chunk fails
+static const char *hasht_str_copy__(struct hasht *ht, const char *str, size_t hash) {
+    struct hasht_str_arena__ *arena = ht->strs;
+    size_t len = strlen(str);
+    size_t sz = (sizeof(struct hasht_str_hdr__) + len + 1 + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    char *mem;
+    if ((size_t) (arena->end - arena->cur) >= sz) {
+        mem = arena->cur;
+        arena->cur += sz;
+    }
+    else {
+        bool own_chunk = sz > HASHT_STR_CHUNK / 4; //keep using what's left of the current chunk
+        size_t chunk_sz = sizeof(struct hasht_str_chunk__) + (own_chunk ? sz : HASHT_STR_CHUNK);
+        struct hasht_str_chunk__ *chunk = ht->memfuncs.alloc(chunk_sz, ht->userdata);
+        if (!chunk)
+            return NULL;
+        mem = (char *) (chunk + 1);
+        if (own_chunk && arena->chunks) {
+            //behind the newest chunk
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        else {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+            arena->cur = mem + sz;
+            arena->end = (char *) chunk + chunk_sz;
+        }
+    }
+    struct hasht_str_hdr__ hdr = { hash, len };
+    memcpy(mem, &hdr, sizeof hdr);
+    memcpy(mem + sizeof hdr, str, len + 1);
+    return mem + sizeof hdr;
+}
+#endif // HASHT_STR_KEYS
+
+//everything but the buckets, which are left for the caller to allocate
+//initial_nbuckets overrides initial_nelements unless it's negative
+static int hasht_init_fields__(struct hasht *ht,
                         long initial_nelements, 
+                        long initial_nbuckets, 
                         hasht_malloc_fptr alloc,
                         hasht_realloc_fptr realloc,
                         hasht_free_fptr free,
+                        hasht_malloc_fptr zalloc,
                         void *userdata,
                         long shrink_at_percentage,
                         long grow_at_percentage)
@@ -366,43 +1007,156 @@ static int hasht_init_ex(struct hasht *ht,
 #ifdef HASHT_DBG
     memset(ht, 0x3c, sizeof *ht);
 #endif
-    const struct hasht_alloc_funcs memfuncs = { alloc, realloc, free, };
+    const struct hasht_alloc_funcs memfuncs = { alloc, realloc, free, zalloc, };
     ht->memfuncs = memfuncs;
     ht->nelements = 0;
     ht->ndeleted = 0;
     ht->nbuckets_po2 = 0;
+    ht->resize_nthreads = 1;
     ht->userdata = userdata;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    ht->old = NULL;
+    ht->migrate_idx = 0;
+#endif
+#ifdef HASHT_STR_KEYS
+    ht->strs = NULL;
+#endif
+#ifdef HASHT_HUGE_PAGES
+    ht->tab_mem.base = NULL;
+    ht->tab_mem.mapped_sz = 0;
+#ifdef HASHT_SOA
+    ht->values_mem = ht->tab_mem;
+#endif
+#endif
+#ifdef HASHT_SNAPSHOT
+    ht->mapping = NULL;
+    ht->mapping_sz = 0;
+#endif
+#ifdef HASHT_STATS
+    memset(&ht->stats, 0, sizeof ht->stats);
+#endif
 
     rv = hasht_init_parameters(ht, shrink_at_percentage, grow_at_percentage);
     if (rv != HASHT_OK)
         return rv;
 
-    long initial_nbuckets = hasht_calc_nelements_to_nbuckets(initial_nelements, ht->shrink_at_percentage, ht->grow_at_percentage);
+    if (initial_nbuckets < 0)
+        initial_nbuckets = hasht_calc_nelements_to_nbuckets(initial_nelements, ht->shrink_at_percentage, ht->grow_at_percentage);
     rv = hasht_change_sz_field(ht, initial_nbuckets, false);
+    ht->min_nbuckets = ht->nbuckets;
+    return rv;
+}
+
+//initial_nbuckets overrides initial_nelements unless it's negative
+//lazy_zero takes the buckets from zalloc (if there's one), which only pays off if they aren't all written to right away:
+//the page faults then come in between the writes, which is slower than clearing everything in one pass first
+static int hasht_init_sz__(struct hasht *ht,
+                        long initial_nelements, 
+                        long initial_nbuckets, 
+                        bool lazy_zero,
+                        hasht_malloc_fptr alloc,
+                        hasht_realloc_fptr realloc,
+                        hasht_free_fptr free,
+                        hasht_malloc_fptr zalloc,
+                        void *userdata,
+                        long shrink_at_percentage,
+                        long grow_at_percentage)
+{
+    int rv = hasht_init_fields__(ht, initial_nelements, initial_nbuckets, alloc, realloc, free, zalloc, userdata, shrink_at_percentage, grow_at_percentage);
     if (rv != HASHT_OK)
         return rv;
 
-    ht->tab = ht->memfuncs.alloc(sizeof(struct hasht_pair_type) * ht->nbuckets, ht->userdata);
+    bool zeroed = lazy_zero && ht->memfuncs.zalloc;
+#ifdef HASHT_HUGE_PAGES
+    ht->tab = hasht_bkt_alloc__(ht, hasht_tab_alloc_sz(ht->nbuckets), &ht->tab_mem, &zeroed);
+#else
+    if (zeroed)
+        ht->tab = ht->memfuncs.zalloc(hasht_tab_alloc_sz(ht->nbuckets), ht->userdata);
+    else
+        ht->tab = ht->memfuncs.alloc(hasht_tab_alloc_sz(ht->nbuckets), ht->userdata);
+#endif
     if (!ht->tab)
         return HASHT_ALLOC_ERR;
-    hasht_memset(ht, 0, ht->nbuckets); //mark everything empty
+#ifdef HASHT_SOA
+    //never read before they're written, no need to clear them
+#ifdef HASHT_HUGE_PAGES
+    bool values_zeroed = false; //they don't need to be
+    ht->values = hasht_bkt_alloc__(ht, sizeof(hasht_value_type) * ht->nbuckets, &ht->values_mem, &values_zeroed);
+#else
+    ht->values = ht->memfuncs.alloc(sizeof(hasht_value_type) * ht->nbuckets, ht->userdata);
+#endif
+    if (!ht->values) {
+#ifdef HASHT_HUGE_PAGES
+        hasht_bkt_free__(ht, &ht->tab_mem);
+#else
+        ht->memfuncs.free(ht->tab, ht->userdata);
+#endif
+        ht->tab = NULL;
+        return HASHT_ALLOC_ERR;
+    }
+#endif
+#ifdef HASHT_CTRL_BYTES
+    ht->ctrl = (unsigned char *) (ht->tab + ht->nbuckets);
+#endif
+    if (!zeroed)
+        hasht_memset(ht, 0, ht->nbuckets); //mark everything empty
+    HASHT_ASSERT(hasht_dbg_check(ht, 0, ht->nbuckets, 1, -1, -1), "zalloc gave memory that isn't zero");
     return HASHT_OK;
 }
 
+static int hasht_init_ex(struct hasht *ht,
+                        long initial_nelements, 
+                        hasht_malloc_fptr alloc,
+                        hasht_realloc_fptr realloc,
+                        hasht_free_fptr free,
+                        void *userdata,
+                        long shrink_at_percentage,
+                        long grow_at_percentage)
+{
+    //calloc() goes with the default free(), other allocators can set ht->memfuncs.zalloc afterwards (it's used from the next resize on)
+    hasht_malloc_fptr zalloc = alloc == hasht_def_malloc ? hasht_def_zalloc : NULL;
+    int rv = hasht_init_sz__(ht, initial_nelements, -1, true, alloc, realloc, free, zalloc, userdata, shrink_at_percentage, grow_at_percentage);
+#ifdef HASHT_STR_KEYS
+    if (rv == HASHT_OK && (rv = hasht_str_arena_init__(ht)) != HASHT_OK)
+        hasht_deinit(ht);
+#endif
+    return rv;
+}
+
 //returns an empty copy that has the same allocator settings and same parameters
-static int hasht_init_copy_settings(struct hasht *ht,
+//the size is given by initial_nbuckets, or calculated from initial_nelements if initial_nbuckets is negative
+//lazy_zero is false for the tables that are filled up right away (see hasht_init_sz__())
+static int hasht_init_copy_settings_sz__(struct hasht *ht,
                         long initial_nelements, 
+                        long initial_nbuckets, 
+                        bool lazy_zero,
                         const struct hasht *source)
 {
-    int rv =  hasht_init_ex(ht, //struct hasht *ht,
+    int rv =  hasht_init_sz__(ht, //struct hasht *ht,
                         initial_nelements, //long initial_nelements, 
+                        initial_nbuckets, //long initial_nbuckets, 
+                        lazy_zero, //bool lazy_zero,
                         source->memfuncs.alloc,//hasht_malloc_fptr alloc,
                         source->memfuncs.realloc,//hasht_realloc_fptr realloc,
                         source->memfuncs.free,// hasht_free_fptr free,
+                        source->memfuncs.zalloc,// hasht_malloc_fptr zalloc,
                         source->userdata, //void *userdata,
                         source->shrink_at_percentage, //long shrink_at_percentage,
                         source->grow_at_percentage //long grow_at_percentage)
                         );
+    ht->resize_nthreads = source->resize_nthreads;
+    ht->min_nbuckets = source->min_nbuckets;
+    return rv;
+}
+static int hasht_init_copy_settings(struct hasht *ht,
+                        long initial_nelements, 
+                        const struct hasht *source)
+{
+    int rv = hasht_init_copy_settings_sz__(ht, initial_nelements, -1, true, source);
+#ifdef HASHT_STR_KEYS
+    if (rv == HASHT_OK && (rv = hasht_str_arena_init__(ht)) != HASHT_OK)
+        hasht_deinit(ht);
+#endif
     return rv;
 }
 
@@ -423,24 +1177,58 @@ static int hasht_init(struct hasht *ht, long initial_nelements) {
 }
 
 static void hasht_deinit(struct hasht *ht) {
-    ht->memfuncs.free(ht->tab, ht->userdata);
+#ifdef HASHT_INCREMENTAL_RESIZE
+    if (ht->old) {
+        hasht_deinit(ht->old);
+        ht->memfuncs.free(ht->old, ht->userdata);
+        ht->old = NULL;
+    }
+#endif
+#ifdef HASHT_SNAPSHOT
+    if (ht->mapping) {
+        munmap(ht->mapping, ht->mapping_sz); //tab and values are in it
+        ht->mapping = NULL;
+    }
+    else
+#endif
+    {
+#ifdef HASHT_HUGE_PAGES
+        hasht_bkt_free__(ht, &ht->tab_mem);
+#ifdef HASHT_SOA
+        hasht_bkt_free__(ht, &ht->values_mem);
+#endif
+#else
+        ht->memfuncs.free(ht->tab, ht->userdata);
+#ifdef HASHT_SOA
+        ht->memfuncs.free(ht->values, ht->userdata);
+#endif
+#endif
+    }
     ht->tab = NULL;
+#ifdef HASHT_SOA
+    ht->values = NULL;
+#endif
+#ifdef HASHT_CTRL_BYTES
+    ht->ctrl = NULL;
+#endif
+#ifdef HASHT_STR_KEYS
+    hasht_str_arena_deinit__(ht);
+#endif
     hasht_zero_sz_field(ht);
 }
-static long hasht_integer_mod_buckets(struct hasht *ht, size_t full_hash) {
-    long divd_hash = ht->div_func(full_hash); //fast division (% not division) by hardcoded primes
-    HASHT_ASSERT(divd_hash < ht->nbuckets, "");
-    return divd_hash;
-}
 
 //precondition: idx can only be in [-1...nbuckets] (inclusive both ends)
 static long hasht_idx_mod_buckets(struct hasht *ht, long idx) {
     HASHT_ASSERT(idx >= -1 && idx <= ht->nbuckets, "");
+#ifdef HASHT_POW2
+    return idx & (ht->nbuckets - 1); //-1 wraps to nbuckets - 1 too
+#else
     if (idx < 0)
         return ht->nbuckets - 1;
     if (idx >= ht->nbuckets)
         return 0;
     return idx;
+#endif
 }
 
 static long hasht_n_unused_buckets(struct hasht *ht) {
@@ -459,62 +1247,202 @@ static long hasht_n_used_buckets(struct hasht *ht) {
 
 
 
+//returns non zero if the hashes tell that the key stored in pair is different
+static int hasht_cmp_hash__(struct hasht_pair_type *pair, size_t full_hash_1, unsigned int partial_hash_1) {
+    (void) pair;
+    (void) full_hash_1;
+    (void) partial_hash_1;
+#if defined(HASHT_STORE_HASH)
+    //stronger than the partial hash check, and a single compare
+    return pair->hash != full_hash_1;
+#else
+    #ifndef HASHT_CTRL_BYTES
+    //skip full key comparison (with HASHT_CTRL_BYTES the partial hash was already matched against the control byte)
+    if (hasht_pr_get_partial_hash(pair) != partial_hash_1)
+        return 1;
+    #endif
+    #if defined(HASHT_STR_KEYS) && !defined(HASHT_INLINE_KEYS)
+    //the full hash is right before the key's bytes, which are needed next anyway
+    return hasht_str_hdr__(pair->key)->hash != full_hash_1;
+    #endif
+    return 0;
+#endif
+}
+
 //returns 0 if equal
-static int hasht_cmp(struct hasht *ht, hasht_key_type *key1, unsigned int partial_hash_1, struct hasht_pair_type *pair) {
+static int hasht_cmp(struct hasht *ht, hasht_key_type *key1, size_t full_hash_1, unsigned int partial_hash_1, struct hasht_pair_type *pair) {
     (void) ht;
+    if (hasht_cmp_hash__(pair, full_hash_1, partial_hash_1))
+        return 1;
+#ifdef HASHT_INLINE_KEYS
+    //key1 isn't padded, so it's compared up to its terminator, the pair's side never leaves the pair
+    int inline_cmp = strncmp(pair->key_inline, *key1, HASHT_INLINE_KEY_SZ);
+    if (inline_cmp != 0 || pair->key_inline[HASHT_INLINE_KEY_SZ - 1] == '\0')
+        return inline_cmp; //different, or the whole key was inline
+    //a long key with the same prefix, check the hash stored with the copy before comparing the rest
+    if (hasht_str_hdr__(pair->key)->hash != full_hash_1)
+        return 1;
+#endif
 
-    //skip full key comparison
-    if (hasht_pr_get_partial_hash(pair) != partial_hash_1)
-        return 1; 
-
-
+//HASHT_SWMR readers compare keys the writer may be moving at the same time, reading the same key twice can differ
 #ifdef HASHT_DATA_ARG
+    #ifndef HASHT_SWMR
     HASHT_ASSERT(hasht_key_eq_cmp(ht->userdata, &pair->key, &pair->key) == 0, "hasht_key_eq_cmp() is broken,"
                                                             " testing it on the same key fails to report it's equal to itself");
+    #endif
     return hasht_key_eq_cmp(ht->userdata, key1, &pair->key);
 #else
+    #ifndef HASHT_SWMR
     HASHT_ASSERT(hasht_key_eq_cmp(&pair->key, &pair->key) == 0, "hasht_key_eq_cmp() is broken,"
                                                             " testing it on the same key fails to report it's equal to itself");
+    #endif
     return hasht_key_eq_cmp(           key1, &pair->key);
 #endif
 }
 
+//the probing functions take either a key, or (if key is NULL) a hasht_probe_type (HASHT_PROBE)
+static int hasht_cmp_lookup__(struct hasht *ht, hasht_key_type *key1, const void *probe, size_t full_hash_1, unsigned int partial_hash_1, struct hasht_pair_type *pair) {
+#ifdef HASHT_PROBE
+    if (!key1) {
+        if (hasht_cmp_hash__(pair, full_hash_1, partial_hash_1))
+            return 1;
+    #ifdef HASHT_DATA_ARG
+        return hasht_probe_eq_cmp(ht->userdata, (hasht_probe_type *) probe, &pair->key);
+    #else
+        return hasht_probe_eq_cmp((hasht_probe_type *) probe, &pair->key);
+    #endif
+    }
+#else
+    (void) probe;
+#endif
+    return hasht_cmp(ht, key1, full_hash_1, partial_hash_1, pair);
+}
+
+#ifdef HASHT_CTRL_BYTES
+//index of the bucket at offset off from idx, off can be up to a group width
+static long hasht_group_pos(struct hasht *ht, long idx, long off) {
+#ifdef HASHT_POW2
+    return (idx + off) & (ht->nbuckets - 1);
+#else
+    long pos = idx + off;
+    while (pos >= ht->nbuckets) //only loops more than once for tables smaller than a group
+        pos -= ht->nbuckets;
+    return pos;
+#endif
+}
+#endif
+
 //on successful match, returns HASHT_OK
 //otherwise unless an error occurs it returns NOT_FOUND and out_idx will hold a suggested place to insert 
 //if we have no suggested place then out_idx is set to NOT_FOUND too
-static inline int hasht_find_pos__(struct hasht *ht, hasht_key_type *key, long *out_idx, size_t *full_hash_out) {
-    HASHT_ASSERT(out_idx && full_hash_out, "");
+//key can be NULL, then probe is what's compared (see hasht_cmp_lookup__)
+//with HASHT_STATS, cnt (unless NULL) gets the probe length and the fingerprint false positives, it's unused otherwise
+struct hasht_probe_count__;
+static inline int hasht_probe_pos__(struct hasht *ht, hasht_key_type *key, const void *probe, size_t full_hash, long *out_idx,
+                                    struct hasht_probe_count__ *cnt) {
+    HASHT_ASSERT(out_idx, "");
+    (void) cnt;
 
-    #ifdef HASHT_DATA_ARG
-        size_t full_hash = hasht_hash(ht->userdata, key);
-    #else
-        size_t full_hash = hasht_hash(key);
-    #endif
-    unsigned int partial_hash = hasht_hash_to_partial_hash(full_hash);
-    *full_hash_out = full_hash;
     long idx = hasht_integer_mod_buckets(ht, full_hash);
     long suggested = HASHT_NOT_FOUND; //suggest where to insert
 
     if (hasht_n_empty_buckets(ht) < 1) {
         //note that if hasht_n_unused_buckets is anywhere near one it'll be a very a slow search anyways
         HASHT_ASSERT(false, "precondition violated, this leads to an infinite loop");
+        *out_idx = HASHT_NOT_FOUND;
         return HASHT_INVALID_TABLE_STATE;
     }
 
+#ifdef HASHT_CTRL_BYTES
+    //same linear probing, but a group of buckets is checked per step
+    unsigned char ctrl = hasht_hash_to_ctrl(full_hash);
+    while (1) {
+#ifdef HASHT_STATS
+        if (cnt)
+            cnt->nprobed++;
+#endif
+        const unsigned char *group = ht->ctrl + idx;
+        hasht_mask_type empty = hasht_group_match(group, HASHT_CTRL_EMPTY);
+        //the probe sequence ends at the first empty bucket, ignore everything after it
+        hasht_mask_type before_empty = empty ? ((empty & (~empty + 1)) - 1) : ~((hasht_mask_type) 0);
+        hasht_mask_type match = hasht_group_match(group, ctrl) & before_empty;
+        while (match) {
+            long pos = hasht_group_pos(ht, idx, hasht_mask_first(match));
+            if (hasht_cmp_lookup__(ht, key, probe, full_hash, 0 /*already matched*/, ht->tab + pos) == 0) {
+                *out_idx = pos;
+                return HASHT_OK; //found
+            }
+#ifdef HASHT_STATS
+            if (cnt && !hasht_cmp_hash__(ht->tab + pos, full_hash, 0))
+                cnt->nfalse++;
+#endif
+            match &= match - 1;
+        }
+        if (suggested == HASHT_NOT_FOUND) {
+            hasht_mask_type deleted = hasht_group_match(group, HASHT_CTRL_DELETED) & before_empty;
+            if (deleted)
+                suggested = hasht_group_pos(ht, idx, hasht_mask_first(deleted));
+        }
+        if (empty) {
+            if (suggested == HASHT_NOT_FOUND)
+                suggested = hasht_group_pos(ht, idx, hasht_mask_first(empty));
+            *out_idx = suggested;
+            return HASHT_NOT_FOUND;
+        }
+        idx = hasht_group_pos(ht, idx, HASHT_GROUP_WIDTH);
+    }
+#else
+    unsigned int partial_hash = hasht_hash_to_partial_hash(full_hash);
+#ifdef HASHT_ROBIN_HOOD
+    //there are no deleted buckets in this mode, and every key that probed past a bucket is at least as far
+    //from its own bucket as the one stored there, so the search ends at the first "richer" entry
+    (void) suggested; //always the bucket where the search stopped
+    for (unsigned int dist = 0; ; dist++) {
+#ifdef HASHT_STATS
+        if (cnt)
+            cnt->nprobed++;
+#endif
+        struct hasht_pair_type *pair = ht->tab + idx;
+        unsigned char flags = hasht_pr_flags(pair); //read once, see hasht_flags_is_empty()
+        if (hasht_flags_is_empty(flags) || pair->probe_dist < dist) {
+            *out_idx = idx; //the new key would go here, displacing whatever is there
+            return HASHT_NOT_FOUND;
+        }
+        HASHT_ASSERT(hasht_flags_is_occupied(flags), "deleted bucket in robin hood mode");
+        if (pair->probe_dist == dist && hasht_cmp_lookup__(ht, key, probe, full_hash, partial_hash, pair) == 0) {
+            *out_idx = idx;
+            return HASHT_OK; //found
+        }
+#ifdef HASHT_STATS
+        if (cnt && pair->probe_dist == dist && !hasht_cmp_hash__(pair, full_hash, partial_hash))
+            cnt->nfalse++;
+#endif
+        idx = hasht_idx_mod_buckets(ht, idx + 1);
+    }
+#else
     //we can probably use an upper iteration count, in case there is memory corruption, but we just ignore that here, we assume the user is sane
     while (1) {
+#ifdef HASHT_STATS
+        if (cnt)
+            cnt->nprobed++;
+#endif
         struct hasht_pair_type *pair = ht->tab + idx;
-        if (hasht_pr_is_occupied(pair)) {
-            if (hasht_cmp(ht, key, partial_hash, pair) == 0) {
+        unsigned char flags = hasht_pr_flags(pair); //read once, see hasht_flags_is_empty()
+        if (hasht_flags_is_occupied(flags)) {
+            if (hasht_cmp_lookup__(ht, key, probe, full_hash, partial_hash, pair) == 0) {
                 *out_idx = idx;
                 return HASHT_OK; //found
             }
+#ifdef HASHT_STATS
+            if (cnt && !hasht_cmp_hash__(pair, full_hash, partial_hash))
+                cnt->nfalse++;
+#endif
         }
-        else if (hasht_pr_is_deleted(pair)) {
+        else if (hasht_flags_is_deleted(flags)) {
             if (suggested == HASHT_NOT_FOUND)
                 suggested = idx; 
         }
-        else if (hasht_pr_is_empty(pair)) {
+        else if (hasht_flags_is_empty(flags)) {
             if (suggested == HASHT_NOT_FOUND)
                 suggested = idx;
             *out_idx = suggested;
@@ -527,15 +1455,109 @@ static inline int hasht_find_pos__(struct hasht *ht, hasht_key_type *key, long *
 #endif
         idx = hasht_idx_mod_buckets(ht, idx + 1); //this is where we can change linear probing
     }
+#endif // HASHT_ROBIN_HOOD
+#endif // HASHT_CTRL_BYTES
 
     //unreachable
     *out_idx = HASHT_NOT_FOUND;
     return HASHT_INVALID_TABLE_STATE;
 }
 
+#ifdef HASHT_STATS
+static void hasht_stats_probed__(struct hasht_stats *st, const struct hasht_probe_count__ *cnt) {
+    long slot = cnt->nprobed - 1;
+    if (slot >= HASHT_STATS_PROBE_HIST)
+        slot = HASHT_STATS_PROBE_HIST - 1;
+    if (slot >= 0)
+        HASHT_STATS_ADD(st, probe_len_hist[slot], 1);
+    if (cnt->nfalse)
+        HASHT_STATS_ADD(st, fingerprint_false_positives, cnt->nfalse);
+}
+//the result of a find of the api
+static void hasht_stats_found__(struct hasht_stats *st, int rv) {
+    HASHT_STATS_ADD(st, finds, 1);
+    if (rv == HASHT_OK)
+        HASHT_STATS_ADD(st, hits, 1);
+    else if (rv == HASHT_NOT_FOUND)
+        HASHT_STATS_ADD(st, misses, 1);
+}
+#endif
+
+static inline int hasht_find_pos_lookup__(struct hasht *ht, hasht_key_type *key, const void *probe, size_t full_hash, long *out_idx) {
+#ifdef HASHT_STATS
+    struct hasht_probe_count__ cnt = { 0, 0 };
+    int rv = hasht_probe_pos__(ht, key, probe, full_hash, out_idx, &cnt);
+    hasht_stats_probed__(&ht->stats, &cnt);
+    return rv;
+#else
+    return hasht_probe_pos__(ht, key, probe, full_hash, out_idx, NULL);
+#endif
+}
+static inline int hasht_find_pos_hashed__(struct hasht *ht, hasht_key_type *key, size_t full_hash, long *out_idx) {
+    return hasht_find_pos_lookup__(ht, key, NULL, full_hash, out_idx);
+}
+
+static size_t hasht_hash__(struct hasht *ht, hasht_key_type *key) {
+#ifdef HASHT_DATA_ARG
+    return hasht_hash(ht->userdata, key);
+#else
+    (void) ht;
+    return hasht_hash(key);
+#endif
+}
+
+#ifdef HASHT_INCREMENTAL_RESIZE
+static int hasht_migrate_step__(struct hasht *ht, long nbuckets_to_visit);
+static long hasht_move_from_old__(struct hasht *ht, long old_idx, size_t full_hash);
+#endif
+
+//the hash of the key stored in pair
+static size_t hasht_pair_hash__(struct hasht *ht, struct hasht_pair_type *pair) {
+#if defined(HASHT_STORE_HASH)
+    (void) ht;
+    return pair->hash;
+#elif defined(HASHT_STR_KEYS)
+    (void) ht;
+    return hasht_str_hdr__(pair->key)->hash;
+#else
+    return hasht_hash__(ht, &pair->key);
+#endif
+}
+
+//same as hasht_find_pos_lookup__, but this is the one used by the api (it also looks at the old table while resizing)
+static inline int hasht_lookup_pos_as__(struct hasht *ht, hasht_key_type *key, const void *probe, size_t full_hash, long *out_idx) {
+    HASHT_ASSERT(out_idx, "");
+
+#ifdef HASHT_INCREMENTAL_RESIZE
+    int step_rv = hasht_migrate_step__(ht, HASHT_INCREMENTAL_STEP);
+    if (step_rv != HASHT_OK) {
+        *out_idx = HASHT_NOT_FOUND;
+        return step_rv;
+    }
+#endif
+    int rv = hasht_find_pos_lookup__(ht, key, probe, full_hash, out_idx);
+#ifdef HASHT_INCREMENTAL_RESIZE
+    long old_idx;
+    if (rv == HASHT_NOT_FOUND && ht->old && hasht_find_pos_lookup__(ht->old, key, probe, full_hash, &old_idx) == HASHT_OK) {
+        //pull it over now, so that callers only ever deal with buckets of the new table
+        long idx = hasht_move_from_old__(ht, old_idx, full_hash);
+        if (idx < 0) {
+            *out_idx = HASHT_NOT_FOUND;
+            return (int) idx;
+        }
+        *out_idx = idx;
+        return HASHT_OK;
+    }
+#endif
+    return rv;
+}
+static inline int hasht_lookup_pos__(struct hasht *ht, hasht_key_type *key, size_t full_hash, long *out_idx) {
+    return hasht_lookup_pos_as__(ht, key, NULL, full_hash, out_idx);
+}
+
 //fwddecl
 static int hasht_init_copy_settings(struct hasht *ht, long initial_nelements, const struct hasht *source);
-static int hasht_insert(struct hasht *ht, hasht_key_type *key, hasht_value_type *value);
+static int hasht_insert_hashed__(struct hasht *ht, hasht_key_type *key, size_t full_hash, hasht_value_type *value, long *found_idx_out, bool or_replace);
 
 static bool hasht_index_within(long start_idx, long cursor_idx, long end_idx_inclusive) {
     if ((start_idx <= end_idx_inclusive && cursor_idx >  end_idx_inclusive                             ) ||
@@ -563,8 +1585,7 @@ static long hasht_skip_to_next__(struct hasht *ht, long start_idx, long cursor_i
     HASHT_ASSERT(cursor_idx >= 0  &&  cursor_idx < ht->nbuckets, "");
     HASHT_ASSERT(start_idx >= 0  &&  start_idx < ht->nbuckets, "");
     for (long i=0; i<ht->nbuckets; i++) {
-        struct hasht_pair_type *pair = ht->tab + cursor_idx;
-        if (hasht_pr_is_occupied(pair)) {
+        if (hasht_bkt_is_occupied(ht, cursor_idx)) {
             return cursor_idx;
         }
         cursor_idx = hasht_idx_mod_buckets(ht, cursor_idx + 1); 
@@ -580,7 +1601,8 @@ static int hasht_copy_all_to(struct hasht *destination, struct hasht *source) {
     long idx = hasht_skip_to_next__(source, 0, HASHT_ITER_FIRST, source->nbuckets - 1);
     while (idx >= 0) {
         struct hasht_pair_type *pair = source->tab + idx;
-        rv = hasht_insert(destination, &pair->key, &pair->value);
+        long idx_unused;
+        rv = hasht_insert_hashed__(destination, &pair->key, hasht_pair_hash__(source, pair), hasht_value_at__(source, idx), &idx_unused, false);
         if (rv != HASHT_OK)
             return rv; //failed in middle of copying
         idx = hasht_skip_to_next__(source, 0, idx, source->nbuckets - 1);
@@ -590,22 +1612,39 @@ static int hasht_copy_all_to(struct hasht *destination, struct hasht *source) {
     return HASHT_OK;
 }
 
-static int hasht_resize__(struct hasht *ht, long new_element_count) {
-
-    long new_bucket_count = hasht_calc_nelements_to_nbuckets(new_element_count, ht->shrink_at_percentage, ht->grow_at_percentage);
-    if (ht->nbuckets_po2 == hasht_get_adiv_power_idx(new_bucket_count)) {
-        return HASHT_OK; 
-        //because we use primes, for some reason both new value and old values map to the same power of two
-        //and there is no point in resizing, since this is an approximate thing it's not a big deal
-    }
-    HASHT_ASSERT(new_bucket_count > HASHT_MIN_TABLESIZE, "");
+static int hasht_copy_all_to_parallel__(struct hasht *dst, struct hasht *src);
+//hasht_copy_all_to() into a new table that is big enough to never grow while copying, in parallel for big tables
+static int hasht_copy_all_to_new__(struct hasht *destination, struct hasht *source) {
+    if (destination->resize_nthreads > 1 && source->nelements >= HASHT_PARALLEL_RESIZE_MIN)
+        return hasht_copy_all_to_parallel__(destination, source);
+    return hasht_copy_all_to(destination, source);
+}
 
-    struct hasht new_ht;
-    int rv = hasht_init_copy_settings(&new_ht, new_bucket_count, ht);
-    if (rv != HASHT_OK) {
-        return rv;
+//moves everything to new_ht, which must be empty and have the same settings, and then replaces ht with it
+static int hasht_migrate_to__(struct hasht *ht, struct hasht *new_ht_ptr) {
+    struct hasht new_ht = *new_ht_ptr;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    //nothing is copied now, ht takes over new_ht and keeps the current buckets as its old table
+    HASHT_ASSERT(!ht->old && !new_ht.old, "a resize is already in progress");
+    struct hasht *old = ht->memfuncs.alloc(sizeof *old, ht->userdata);
+    if (!old) {
+        hasht_deinit(&new_ht);
+        return HASHT_ALLOC_ERR;
     }
-    rv = hasht_copy_all_to(&new_ht, ht);
+    memcpy(old, ht, sizeof *old);
+    new_ht.nelements = old->nelements;
+#ifdef HASHT_STATS
+    new_ht.stats = old->stats;
+#endif
+    memcpy(ht, &new_ht, sizeof *ht);
+    ht->old = old;
+    ht->migrate_idx = 0;
+#ifdef HASHT_STR_KEYS
+    hasht_str_arena_move__(ht, old);
+#endif
+    return HASHT_OK;
+#else
+    int rv = hasht_copy_all_to_new__(&new_ht, ht);
     if (rv != HASHT_OK) {
         hasht_deinit(&new_ht);
         return rv;
@@ -614,11 +1653,166 @@ static int hasht_resize__(struct hasht *ht, long new_element_count) {
     HASHT_ASSERT(new_ht.ndeleted == 0, "copying failed");
 
     //swap and deinit
+#ifdef HASHT_STR_KEYS
+    hasht_str_arena_move__(&new_ht, ht);
+#endif
+#ifdef HASHT_STATS
+    new_ht.stats = ht->stats; //the lookups of copying aren't counted
+#endif
     hasht_deinit(ht);
     memcpy(ht, &new_ht, sizeof *ht);
 
     HASHT_ASSERT(hasht_dbg_sanity_heavy(ht), "");
 
+    return HASHT_OK;
+#endif // HASHT_INCREMENTAL_RESIZE
+}
+
+#ifdef HASHT_STATS
+static long hasht_stats_now_ns__(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long) ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+//a resize to new_ht, that took since begin_ns
+static void hasht_stats_resized__(struct hasht_stats *st, const struct hasht *new_ht, long begin_ns) {
+    long bytes = (long) hasht_tab_alloc_sz(new_ht->nbuckets);
+#ifdef HASHT_SOA
+    bytes += (long) sizeof(hasht_value_type) * new_ht->nbuckets;
+#endif
+    HASHT_STATS_ADD(st, resizes, 1);
+    HASHT_STATS_ADD(st, resize_bytes, bytes);
+    HASHT_STATS_ADD(st, resize_ns, hasht_stats_now_ns__() - begin_ns);
+}
+#endif
+
+//allocates the new buckets (the arguments are the ones of hasht_init_copy_settings_sz__) and moves everything there
+static int hasht_resize_to__(struct hasht *ht, long new_nelements, long new_nbuckets) {
+#ifdef HASHT_STATS
+    long begin_ns = hasht_stats_now_ns__();
+#endif
+    struct hasht new_ht;
+    int rv = hasht_init_copy_settings_sz__(&new_ht, new_nelements, new_nbuckets, HASHT_RESIZE_LAZY_ZERO, ht);
+    if (rv != HASHT_OK) {
+        return rv;
+    }
+    rv = hasht_migrate_to__(ht, &new_ht);
+#ifdef HASHT_STATS
+    if (rv == HASHT_OK)
+        hasht_stats_resized__(&ht->stats, ht, begin_ns);
+#endif
+    return rv;
+}
+
+static int hasht_resize__(struct hasht *ht, long new_element_count) {
+
+    long new_bucket_count = hasht_calc_nelements_to_nbuckets(new_element_count, ht->shrink_at_percentage, ht->grow_at_percentage);
+    if (ht->nbuckets_po2 == hasht_get_power_idx(new_bucket_count)) {
+        return HASHT_OK; 
+        //because we use primes, for some reason both new value and old values map to the same power of two
+        //and there is no point in resizing, since this is an approximate thing it's not a big deal
+    }
+    HASHT_ASSERT(new_bucket_count > HASHT_MIN_TABLESIZE, "");
+    return hasht_resize_to__(ht, new_bucket_count, -1);
+}
+
+//same as hasht_resize__ but the new size is given in buckets
+static int hasht_resize_nbuckets__(struct hasht *ht, long new_nbuckets) {
+    if (ht->nbuckets_po2 == hasht_get_power_idx(new_nbuckets))
+        return HASHT_OK;
+    return hasht_resize_to__(ht, 0, new_nbuckets);
+}
+
+//the bucket count that a table would really get for a request of nbuckets, negative if it's too big
+static long hasht_round_nbuckets__(long nbuckets) {
+    nbuckets = nbuckets < HASHT_MIN_TABLESIZE ? HASHT_MIN_TABLESIZE : nbuckets;
+    long nbuckets_po2 = hasht_get_power_idx(nbuckets);
+    if (nbuckets_po2 < 0)
+        return HASHT_INVALID_REQ_SZ;
+#ifdef HASHT_POW2
+    return 1L << nbuckets_po2;
+#else
+    return HASHT_ADIV_VALUES[nbuckets_po2];
+#endif
+}
+
+//free() can keep the memory of the old buckets in the heap, this gives it back to the os
+//malloc_trim() walks the whole heap of the process, so only hasht_shrink_to_fit() asks for it
+static void hasht_release_freed__(struct hasht *ht) {
+#ifdef __GLIBC__
+    if (ht->memfuncs.free == hasht_def_free)
+        malloc_trim(0);
+#else
+    (void) ht;
+#endif
+}
+
+//resizes to a smaller size right away (also with HASHT_INCREMENTAL_RESIZE, it has few elements to move anyway)
+static int hasht_shrink__(struct hasht *ht, long new_nbuckets) {
+    int rv = hasht_resize_nbuckets__(ht, new_nbuckets);
+#ifdef HASHT_INCREMENTAL_RESIZE
+    if (rv == HASHT_OK)
+        rv = hasht_migrate_step__(ht, LONG_MAX);
+#endif
+    return rv;
+}
+
+//fwddecl
+static void hasht_mark_as_empty__(struct hasht *ht, long at_index);
+
+//moves the pair at from_idx to the empty bucket to_idx, and marks from_idx as empty
+static void hasht_bkt_move__(struct hasht *ht, long from_idx, long to_idx) {
+    HASHT_ASSERT(hasht_bkt_is_occupied(ht, from_idx) && hasht_bkt_is_empty(ht, to_idx), "");
+    ht->tab[to_idx] = ht->tab[from_idx];
+#ifdef HASHT_SOA
+    memcpy(ht->values + to_idx, ht->values + from_idx, sizeof *ht->values);
+#endif
+#ifdef HASHT_CTRL_BYTES
+    hasht_bkt_set_ctrl(ht, to_idx, ht->ctrl[from_idx]);
+#endif
+    hasht_mark_as_empty__(ht, from_idx);
+}
+
+//clears all deleted buckets without allocating, every pair is moved to the first bucket that is free in its probe sequence
+//this walks the table once starting after an empty bucket, no probe sequence crosses an empty bucket
+//so every pair's bucket (the one the hash maps to) was already visited by the time we reach it,
+//and visited buckets only ever go from empty to occupied
+static int hasht_purge_deleted(struct hasht *ht) {
+    HASHT_ASSERT(hasht_dbg_sanity_01(ht), "hasht corrupt or not initialized");
+    if (ht->ndeleted == 0)
+        return HASHT_OK;
+    long start_idx = HASHT_NOT_FOUND;
+    for (long i=0; i<ht->nbuckets; i++) {
+        if (hasht_bkt_is_empty(ht, i)) {
+            start_idx = i;
+            break;
+        }
+    }
+    if (start_idx == HASHT_NOT_FOUND) {
+        HASHT_ASSERT(false, "no empty bucket");
+        return HASHT_INVALID_TABLE_STATE;
+    }
+
+    long idx = start_idx;
+    for (long n=0; n<ht->nbuckets; n++) {
+        idx = hasht_idx_mod_buckets(ht, idx + 1);
+        if (hasht_bkt_is_deleted(ht, idx)) {
+            hasht_mark_as_empty__(ht, idx);
+        }
+        else if (hasht_bkt_is_occupied(ht, idx)) {
+            long to_idx = hasht_integer_mod_buckets(ht, hasht_pair_hash__(ht, ht->tab + idx));
+            while (to_idx != idx && !hasht_bkt_is_empty(ht, to_idx))
+                to_idx = hasht_idx_mod_buckets(ht, to_idx + 1);
+            if (to_idx != idx)
+                hasht_bkt_move__(ht, idx, to_idx);
+        }
+    }
+#ifdef HASHT_STATS
+    HASHT_STATS_ADD(&ht->stats, tombstones_purged, ht->ndeleted);
+#endif
+    ht->ndeleted = 0;
+    HASHT_ASSERT(hasht_dbg_sanity_heavy(ht), "");
+    HASHT_ASSERT(hasht_dbg_check(ht, 0, ht->nbuckets, 0, -1, -1), "deleted bucket left after purge");
     return HASHT_OK;
 }
 
@@ -627,14 +1821,51 @@ enum hasht_hint {
     HASHT_HINT_INSERTING,
     HASHT_HINT_DELETING,
 };
+//shrinking starts below shrink_at_percentage and goes to the middle of the two percentages, growing starts above grow_at_percentage:
+//after either one it takes many inserts or removes to get to the next resize
+static bool hasht_wants_shrink__(struct hasht *ht) {
+    return ht->nelements < ht->shrink_at_lt_n && ht->nbuckets > ht->min_nbuckets;
+}
+//the bucket count to shrink to, 0 if it shouldn't shrink
+//the sizes a table uses are far apart, the target can round back up to the current size, that's no shrink either
+static long hasht_shrink_target__(struct hasht *ht) {
+    if (!hasht_wants_shrink__(ht))
+        return 0;
+    long new_nbuckets = hasht_calc_nelements_to_nbuckets(ht->nelements, ht->shrink_at_percentage, ht->grow_at_percentage);
+    if (new_nbuckets < ht->min_nbuckets)
+        new_nbuckets = ht->min_nbuckets;
+    if (hasht_round_nbuckets__(new_nbuckets) >= ht->nbuckets)
+        return 0;
+    return new_nbuckets;
+}
 static int hasht_if_needed_try_resize(struct hasht *ht, int hint) {
     int rv = HASHT_OK;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    bool wants_grow   = ht->nelements >= ht->grow_at_gt_n && (hint != HASHT_HINT_DELETING);
+    bool wants_shrink = hasht_shrink_target__(ht) > 0 && (hint != HASHT_HINT_INSERTING);
+    if (ht->old && (wants_grow || wants_shrink)) {
+        //the previous resize didn't finish in time, finish it now
+        rv = hasht_migrate_step__(ht, LONG_MAX);
+        if (rv != HASHT_OK)
+            return rv;
+    }
+#endif
     //avoids trying to shrink when we're inserting, and avoids trying to grow when we're removing elements
     if (ht->nelements >= ht->grow_at_gt_n && (hint != HASHT_HINT_DELETING)) {
+#ifdef HASHT_POW2
+        rv = hasht_resize_nbuckets__(ht, ht->nbuckets * 2); //always exactly double
+#else
         rv = hasht_resize__(ht, ht->nelements);
+#endif
     }
-    else if ((ht->nelements < ht->shrink_at_lt_n) && ((ht->nbuckets / 2) < HASHT_MIN_TABLESIZE) && (hint != HASHT_HINT_INSERTING)) {
-        rv = hasht_resize__(ht, ht->nelements);
+    else if (ht->ndeleted >= ht->purge_at_deleted_n && (hint != HASHT_HINT_DELETING)) {
+        //inserting is the only thing that uses up empty buckets, deleted ones are never reused unless the same probe sequence comes along
+        rv = hasht_purge_deleted(ht);
+    }
+    else if (hint != HASHT_HINT_INSERTING) {
+        long new_nbuckets = hasht_shrink_target__(ht);
+        if (new_nbuckets > 0)
+            rv = hasht_shrink__(ht, new_nbuckets);
     }
     return rv;
 }
@@ -648,18 +1879,73 @@ static int hasht_set_pair_at_pos__(struct hasht *ht, size_t full_hash, hasht_key
     HASHT_ASSERT(ht->nelements < ht->nbuckets, "");
     HASHT_ASSERT(place_to_insert_idx >= 0 && place_to_insert_idx < ht->nbuckets , "");
     struct hasht_pair_type *pair = ht->tab + place_to_insert_idx;
+#ifdef HASHT_ROBIN_HOOD
+    long home_idx = hasht_integer_mod_buckets(ht, full_hash);
+    unsigned int dist = (unsigned int) (place_to_insert_idx >= home_idx ? place_to_insert_idx - home_idx
+                                                                        : place_to_insert_idx - home_idx + ht->nbuckets);
+    if (hasht_pr_is_occupied(pair)) {
+        //take the bucket from the richer entry, and keep pushing displaced entries forward until one lands in an empty bucket
+        struct hasht_pair_type carry = *pair;
+#ifdef HASHT_SOA
+        hasht_value_type carry_value, tmp_value;
+        memcpy(&carry_value, ht->values + place_to_insert_idx, sizeof carry_value);
+#endif
+        long idx = place_to_insert_idx;
+        while (1) {
+            idx = hasht_idx_mod_buckets(ht, idx + 1);
+            carry.probe_dist++;
+            struct hasht_pair_type *cur = ht->tab + idx;
+            if (hasht_pr_is_empty(cur)) {
+                *cur = carry;
+#ifdef HASHT_SOA
+                memcpy(ht->values + idx, &carry_value, sizeof carry_value);
+#endif
+                break;
+            }
+            if (cur->probe_dist < carry.probe_dist) {
+                struct hasht_pair_type tmp = *cur;
+                *cur = carry;
+                carry = tmp;
+#ifdef HASHT_SOA
+                memcpy(&tmp_value, ht->values + idx, sizeof tmp_value);
+                memcpy(ht->values + idx, &carry_value, sizeof carry_value);
+                memcpy(&carry_value, &tmp_value, sizeof carry_value);
+#endif
+            }
+        }
+    }
+    pair->probe_dist = dist;
+#endif // HASHT_ROBIN_HOOD
+#ifdef HASHT_CTRL_BYTES
+    hasht_bkt_set_ctrl(ht, place_to_insert_idx, hasht_hash_to_ctrl(full_hash));
+#else
     pair->pair_data = hasht_pr_combine_flags_and_partial_hash(HASHT_VLT_IS_NOT_EMPTY, //flags
                                                         hasht_hash_to_partial_hash(full_hash));
+#endif
+#ifdef HASHT_STORE_HASH
+    pair->hash = full_hash;
+#endif
+#ifdef HASHT_INLINE_KEYS
+    size_t inline_len = strnlen(*key, HASHT_INLINE_KEY_SZ); //strncpy(), without the truncation warning
+    memcpy(pair->key_inline, *key, inline_len);
+    memset(pair->key_inline + inline_len, 0, HASHT_INLINE_KEY_SZ - inline_len);
+#endif
     memcpy(&pair->key, key, sizeof *key);
-    memcpy(&pair->value, value, sizeof *value);
+    memcpy(hasht_value_at__(ht, place_to_insert_idx), value, sizeof *value);
     return HASHT_OK;
 }
 
-static int hasht_insert__(struct hasht *ht, hasht_key_type *key, hasht_value_type *value, long *found_idx_out, bool or_replace) {
+static int hasht_insert_hashed__(struct hasht *ht, hasht_key_type *key, size_t full_hash, hasht_value_type *value, long *found_idx_out, bool or_replace) {
     HASHT_ASSERT(hasht_dbg_sanity_01(ht), "hasht corrupt or not initialized");
     HASHT_ASSERT(ht->nelements < ht->nbuckets, "");
     HASHT_ASSERT(found_idx_out, "");
     long found_idx;
+#ifdef HASHT_STR_KEYS
+    hasht_key_type key_copy;
+    #ifdef HASHT_STR_VALUES
+    hasht_value_type value_copy;
+    #endif
+#endif
     int rv = hasht_if_needed_try_resize(ht, HASHT_HINT_INSERTING);
     if (rv != HASHT_OK && hasht_at_insert_must_resize(ht)) {
         //failed, translate the error
@@ -669,8 +1955,7 @@ static int hasht_insert__(struct hasht *ht, hasht_key_type *key, hasht_value_typ
             return HASHT_FAILED_AT_RESIZE;
     }
 
-    size_t full_hash;
-    rv = hasht_find_pos__(ht, key, &found_idx, &full_hash);
+    rv = hasht_lookup_pos__(ht, key, full_hash, &found_idx);
 
     if (found_idx == HASHT_NOT_FOUND) {
         //weird error, we were expecting either:
@@ -687,10 +1972,32 @@ static int hasht_insert__(struct hasht *ht, hasht_key_type *key, hasht_value_typ
     }
     else if (rv == HASHT_NOT_FOUND) {
         //not a duplicate, new element
-        struct hasht_pair_type *pair = ht->tab + found_idx; 
-        if (hasht_pr_is_deleted(pair)) {
+#ifdef HASHT_STR_KEYS
+        if (ht->strs) {
+            key_copy = hasht_str_copy__(ht, *key, full_hash);
+            if (!key_copy) {
+                *found_idx_out = HASHT_NOT_FOUND;
+                return HASHT_ALLOC_ERR;
+            }
+            key = &key_copy;
+    #ifdef HASHT_STR_VALUES
+            if (*value) {
+                value_copy = (hasht_value_type) hasht_str_copy__(ht, *value, 0);
+                if (!value_copy) {
+                    *found_idx_out = HASHT_NOT_FOUND;
+                    return HASHT_ALLOC_ERR; //the key's copy stays in the arena until hasht_deinit()
+                }
+                value = &value_copy;
+            }
+    #endif
+        }
+#endif
+        if (hasht_bkt_is_deleted(ht, found_idx)) {
             HASHT_ASSERT(ht->ndeleted > 0, "found a deleted element even though ht->ndeleted <= 0");
             ht->ndeleted--;
+#ifdef HASHT_STATS
+            HASHT_STATS_ADD(&ht->stats, tombstones_reused, 1);
+#endif
         }
         ht->nelements++;
     }
@@ -699,6 +2006,27 @@ static int hasht_insert__(struct hasht *ht, hasht_key_type *key, hasht_value_typ
         *found_idx_out = HASHT_NOT_FOUND;
         return rv;
     }
+    else {
+        //replacing, the bucket and its flags stay as they are (robin hood would otherwise displace the old pair)
+#ifdef HASHT_STR_KEYS
+        //the stored copy of the key is kept, it's equal anyway
+    #ifdef HASHT_STR_VALUES
+        if (ht->strs && *value) {
+            value_copy = (hasht_value_type) hasht_str_copy__(ht, *value, 0);
+            if (!value_copy) {
+                *found_idx_out = HASHT_NOT_FOUND;
+                return HASHT_ALLOC_ERR;
+            }
+            value = &value_copy;
+        }
+    #endif
+#else
+        memcpy(&ht->tab[found_idx].key, key, sizeof *key);
+#endif
+        memcpy(hasht_value_at__(ht, found_idx), value, sizeof *value);
+        *found_idx_out = found_idx;
+        return HASHT_OK;
+    }
 
     rv = hasht_set_pair_at_pos__(ht, full_hash, key, value, found_idx);
     *found_idx_out = found_idx;
@@ -712,6 +2040,16 @@ static int hasht_insert__(struct hasht *ht, hasht_key_type *key, hasht_value_typ
 //this _doesnt_ happen when we delete an element where the one next to it is filled or deleted:
 // [filled] [filled] [filled and to be deleted] [filled or deleted] [filled] [empty]
 //                    ^^^mark as deleted^^^^     ^next^
+#ifdef HASHT_CTRL_BYTES
+static void hasht_mark_as_empty__(struct hasht *ht, long at_index) {
+    HASHT_ASSERT(!hasht_bkt_is_empty(ht, at_index), "");
+    hasht_bkt_set_ctrl(ht, at_index, HASHT_CTRL_EMPTY);
+}
+static void hasht_mark_as_deleted__(struct hasht *ht, long at_index) {
+    HASHT_ASSERT(hasht_bkt_is_occupied(ht, at_index), "trying to delete an empty element");
+    hasht_bkt_set_ctrl(ht, at_index, HASHT_CTRL_DELETED);
+}
+#else
 static void hasht_mark_as_empty__(struct hasht *ht, long at_index) {
     struct hasht_pair_type *pair = ht->tab + at_index; 
     HASHT_ASSERT(!hasht_pr_is_empty(pair), "");
@@ -733,32 +2071,36 @@ static void hasht_mark_as_deleted__(struct hasht *ht, long at_index) {
                   hasht_pr_flags(pair) | HASHT_VLT_IS_DELETED);
     HASHT_ASSERT(hasht_pr_is_deleted(pair), "");
 }
-
-static int hasht_remove(struct hasht *ht, hasht_key_type *key) {
-    long found_idx;
-    size_t full_hash;
-    int rv = hasht_find_pos__(ht, key, &found_idx, &full_hash);
-    if (rv == HASHT_NOT_FOUND) {
-        return rv;
-    }
-    else if (rv != HASHT_OK) {
-        //failed, TODO: check what's the error
-        return rv;
+#endif // HASHT_CTRL_BYTES
+
+//removes the occupied bucket at found_idx, full_hash is the hash of the key stored there
+static void hasht_remove_at__(struct hasht *ht, long found_idx, size_t full_hash) {
+    HASHT_ASSERT(found_idx >= 0 && found_idx < ht->nbuckets, "invalid index");
+    HASHT_ASSERT(hasht_bkt_is_occupied(ht, found_idx), "removing a deleted/empty element");
+    (void) full_hash; //only needed without HASHT_AGRESSIVE_CLEANUP
+#ifdef HASHT_ROBIN_HOOD
+    //backward shift: pull the following entries one bucket closer to home until one is already home (or empty)
+    //this keeps the table free of deleted buckets
+    long idx = found_idx;
+    long next_idx = hasht_idx_mod_buckets(ht, idx + 1);
+    while (!hasht_pr_is_empty(ht->tab + next_idx) && ht->tab[next_idx].probe_dist > 0) {
+        ht->tab[idx] = ht->tab[next_idx];
+        ht->tab[idx].probe_dist--;
+#ifdef HASHT_SOA
+        memcpy(ht->values + idx, ht->values + next_idx, sizeof *ht->values);
+#endif
+        idx = next_idx;
+        next_idx = hasht_idx_mod_buckets(ht, idx + 1);
     }
-    HASHT_ASSERT(found_idx >= 0 && found_idx < ht->nbuckets, "find pos returned invalid index");
-#ifdef HASHT_DBG
-        struct hasht_pair_type *pair = ht->tab + found_idx;
-        HASHT_ASSERT(hasht_pr_is_occupied(pair), "find pos returned an index of a deleted/empty element");
-#endif // HASHT_DBG
-
+    hasht_mark_as_empty__(ht, idx);
+#else
     //optimization: if next element is empty, mark our element as empty too, otherwise mark our element as deleted
     //TODO: benchmark this
     long next_idx = hasht_idx_mod_buckets(ht, found_idx + 1); //this assumes linear probing
-    struct hasht_pair_type *next_pair = ht->tab + next_idx;
     //TODO, division even though it is fast can be optimized to be a branch in wrap around cases
     //After benchmarking this, the results were: cleaning up in general made things faster by 2.0%
     //HASHT_AGRESSIVE_CLEANUP made things faster by about 0.5% (which is insignificant)
-    if (hasht_pr_is_empty(next_pair)) {
+    if (hasht_bkt_is_empty(ht, next_idx)) {
         hasht_mark_as_empty__(ht, found_idx);
 
         //^TODO: add tests that extensively test the table state after lots of deletions
@@ -782,12 +2124,13 @@ static int hasht_remove(struct hasht *ht, hasht_key_type *key) {
         #define HASHT_AGRESSIVE_CLEANUP
         #ifdef HASHT_AGRESSIVE_CLEANUP
             long prev_idx = hasht_idx_mod_buckets(ht, found_idx - 1);
-            struct hasht_pair_type *prev_pair = ht->tab + prev_idx;
-            while (hasht_pr_is_deleted(prev_pair)) {
+            while (hasht_bkt_is_deleted(ht, prev_idx)) {
                 hasht_mark_as_empty__(ht, prev_idx);
-                HASHT_ASSERT(hasht_pr_is_empty(prev_pair), "");
+                HASHT_ASSERT(hasht_bkt_is_empty(ht, prev_idx), "");
+#ifdef HASHT_STATS
+                HASHT_STATS_ADD(&ht->stats, tombstones_reclaimed, 1);
+#endif
                 prev_idx = hasht_idx_mod_buckets(ht, prev_idx - 1); 
-                prev_pair = ht->tab + prev_idx;
             }
         #else
             long supposed_to_be_in_idx = hasht_integer_mod_buckets(ht, full_hash);
@@ -795,57 +2138,261 @@ static int hasht_remove(struct hasht *ht, hasht_key_type *key) {
             if (probe_len < 0)
                 probe_len = probe_len + ht->nbuckets;
             long prev_idx = hasht_idx_mod_buckets(ht, found_idx - 1);
-            struct hasht_pair_type *prev_pair = ht->tab + prev_idx;
-            for (long i = 0; i < probe_len && hasht_pr_is_deleted(prev_pair); i++) {
+            for (long i = 0; i < probe_len && hasht_bkt_is_deleted(ht, prev_idx); i++) {
                 hasht_mark_as_empty__(ht, prev_idx);
-                HASHT_ASSERT(hasht_pr_is_empty(prev_pair), "");
+                HASHT_ASSERT(hasht_bkt_is_empty(ht, prev_idx), "");
                 prev_idx = hasht_idx_mod_buckets(ht, prev_idx - 1); 
-                prev_pair = ht->tab + prev_idx;
             }
         #endif // HASHT_AGRESSIVE_CLEANUP
     }
     else {
         hasht_mark_as_deleted__(ht, found_idx);
         ht->ndeleted++;
+#ifdef HASHT_STATS
+        HASHT_STATS_ADD(&ht->stats, tombstones_created, 1);
+#endif
     }
+#endif // HASHT_ROBIN_HOOD
 
     ht->nelements--;
-    return HASHT_OK;
 }
-static int hasht_insert(struct hasht *ht, hasht_key_type *key, hasht_value_type *value) {
-    long idx_unused;
-    int rv = hasht_insert__(ht, key, value, &idx_unused, false /*dont replace*/);
-    return rv;
+
+#ifdef HASHT_INCREMENTAL_RESIZE
+//moves the entry at old_idx of the old table into ht, returns the index it landed at (or a negative error)
+//ht->nelements already counts it
+static long hasht_move_from_old__(struct hasht *ht, long old_idx, size_t full_hash) {
+    struct hasht *old = ht->old;
+    struct hasht_pair_type *pair = old->tab + old_idx;
+    long idx;
+    //part of the resize, not a lookup of the user's (HASHT_STATS)
+    int rv = hasht_probe_pos__(ht, &pair->key, NULL, full_hash, &idx, NULL);
+    if (rv != HASHT_NOT_FOUND || idx < 0) {
+        HASHT_ASSERT(false, "key is in both tables");
+        return HASHT_INVALID_TABLE_STATE;
+    }
+    if (hasht_bkt_is_deleted(ht, idx))
+        ht->ndeleted--;
+    hasht_set_pair_at_pos__(ht, full_hash, &pair->key, hasht_value_at__(ht->old, old_idx), idx);
+    hasht_remove_at__(old, old_idx, full_hash);
+    return idx;
 }
-struct hasht_iter {
-    long started_at_idx;
-    long current_idx;
-    //public field
-    //the two members: pair->key and pair->value can be accessed directly (assuming a valid iterator)
-    struct hasht_pair_type *pair; 
-};
-static struct hasht_iter hasht_mk_invalid_iter(void) {
-    struct hasht_iter iter = {HASHT_ITER_STOP, HASHT_ITER_STOP, NULL};
-    return iter;
+
+//visits up to nbuckets_to_visit buckets of the old table, and frees it once it's empty
+static int hasht_migrate_step__(struct hasht *ht, long nbuckets_to_visit) {
+    struct hasht *old = ht->old;
+    if (!old)
+        return HASHT_OK;
+    for (long i=0; i<nbuckets_to_visit && old->nelements > 0; i++) {
+        if (ht->migrate_idx >= old->nbuckets)
+            ht->migrate_idx = 0; //robin hood's backward shift can move an entry from the start to the end
+        if (hasht_bkt_is_occupied(old, ht->migrate_idx)) {
+            //don't advance, the removal can shift the next entry back into this bucket
+            long rv = hasht_move_from_old__(ht, ht->migrate_idx, hasht_pair_hash__(old, old->tab + ht->migrate_idx));
+            if (rv < 0)
+                return (int) rv;
+        }
+        else {
+            ht->migrate_idx++;
+        }
+    }
+    if (old->nelements == 0) {
+        hasht_deinit(old);
+        ht->memfuncs.free(old, ht->userdata);
+        ht->old = NULL;
+        ht->migrate_idx = 0;
+        HASHT_ASSERT(hasht_dbg_sanity_heavy(ht), "");
+    }
+    return HASHT_OK;
 }
-static struct hasht_iter hasht_mk_iter(long start_idx, struct hasht_pair_type *pair) {
-    struct hasht_iter iter = {start_idx, HASHT_ITER_FIRST, pair};
-    return iter;
+
+//finishes a resize that is in progress, if any
+static int hasht_finish_resize(struct hasht *ht) {
+    return hasht_migrate_step__(ht, LONG_MAX);
 }
-static bool hasht_iter_check(struct hasht_iter *iter) {
-    HASHT_ASSERT((iter->current_idx == HASHT_ITER_STOP) || (iter->pair != NULL && iter->current_idx >= 0), "invalid iterator state");
-    return iter->current_idx != HASHT_ITER_STOP;
+#endif // HASHT_INCREMENTAL_RESIZE
+
+//the hash that hasht_hash() gives for key, for the _hashed functions
+//it only depends on the key (and userdata with HASHT_DATA_ARG), never on the table, so the same hash
+//can be passed to every table that has the same hasht_hash() and the same userdata
+static size_t hasht_hash_key(struct hasht *ht, hasht_key_type *key) {
+    return hasht_hash__(ht, key);
 }
 
-static int hasht_begin_iterator(struct hasht *ht, struct hasht_iter *iter) {
-    long next_idx = hasht_skip_to_next__(ht, 0, HASHT_ITER_FIRST, ht->nbuckets - 1);
-    if (next_idx < 0) {
+//the _hashed functions are the same as the ones without the suffix, but they take full_hash (see hasht_hash_key())
+//instead of calling hasht_hash(), which is then only called when resizing without HASHT_STORE_HASH
+//passing a different hash than hasht_hash_key() would is undefined (the key is looked up in the wrong place)
+static int hasht_remove_hashed(struct hasht *ht, hasht_key_type *key, size_t full_hash) {
+    long found_idx;
+    int rv = hasht_lookup_pos__(ht, key, full_hash, &found_idx);
+    if (rv == HASHT_NOT_FOUND) {
+        return rv;
+    }
+    else if (rv != HASHT_OK) {
+        //failed, TODO: check what's the error
+        return rv;
+    }
+    HASHT_ASSERT(found_idx >= 0 && found_idx < ht->nbuckets, "find pos returned invalid index");
+    HASHT_ASSERT(hasht_bkt_is_occupied(ht, found_idx), "find pos returned an index of a deleted/empty element");
+
+    hasht_remove_at__(ht, found_idx, full_hash);
+    //the pair is removed even if shrinking fails
+    hasht_if_needed_try_resize(ht, HASHT_HINT_DELETING);
+    return HASHT_OK;
+}
+static int hasht_remove(struct hasht *ht, hasht_key_type *key) {
+    return hasht_remove_hashed(ht, key, hasht_hash__(ht, key));
+}
+static int hasht_insert_hashed(struct hasht *ht, hasht_key_type *key, size_t full_hash, hasht_value_type *value) {
+    long idx_unused;
+    int rv = hasht_insert_hashed__(ht, key, full_hash, value, &idx_unused, false /*dont replace*/);
+    return rv;
+}
+static int hasht_insert(struct hasht *ht, hasht_key_type *key, hasht_value_type *value) {
+    return hasht_insert_hashed(ht, key, hasht_hash__(ht, key), value);
+}
+
+//makes room for nelements in total, so inserting up to that many won't resize, and the table won't shrink below it on its own
+static int hasht_reserve(struct hasht *ht, long nelements) {
+    if (nelements < 0)
+        return HASHT_INVALID_REQ_SZ;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    int rv = hasht_finish_resize(ht);
+    if (rv != HASHT_OK)
+        return rv;
+#else
+    int rv;
+#endif
+    if (nelements >= ht->grow_at_gt_n) {
+        rv = hasht_resize_nbuckets__(ht, hasht_calc_nelements_to_nbuckets(nelements, ht->shrink_at_percentage, ht->grow_at_percentage));
+        if (rv != HASHT_OK)
+            return rv;
+    }
+    ht->min_nbuckets = ht->nbuckets;
+    return HASHT_OK;
+}
+
+//resizes to nbuckets (rounded up to the next size the table uses), which then also becomes the size it doesn't shrink below on its own
+//without force, sizes that would be over the growth threshold right away are refused (HASHT_RESIZE_REFUSE),
+//with force any size that has room for the elements and one empty bucket is used (HASHT_INVALID_REQ_SZ otherwise)
+//the same size as now clears out the deleted buckets
+static int hasht_rehash(struct hasht *ht, long nbuckets, bool force) {
+    long new_nbuckets = hasht_round_nbuckets__(nbuckets);
+    if (new_nbuckets < 0)
+        return (int) new_nbuckets;
+    if (new_nbuckets <= ht->nelements + 1)
+        return HASHT_INVALID_REQ_SZ;
+    if (!force && ht->nelements >= hasht_mul_div(new_nbuckets, ht->grow_at_percentage, 100))
+        return HASHT_RESIZE_REFUSE;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    int rv = hasht_finish_resize(ht);
+    if (rv != HASHT_OK)
+        return rv;
+#else
+    int rv;
+#endif
+    if (new_nbuckets == ht->nbuckets)
+        rv = hasht_purge_deleted(ht);
+    else if (new_nbuckets < ht->nbuckets)
+        rv = hasht_shrink__(ht, new_nbuckets);
+    else
+        rv = hasht_resize_nbuckets__(ht, new_nbuckets);
+    if (rv != HASHT_OK)
+        return rv;
+    ht->min_nbuckets = ht->nbuckets;
+    return HASHT_OK;
+}
+
+//shrinks to the size the table would shrink to on its own, and returns the memory of the old buckets to the os (see hasht_release_freed__())
+//with the default allocator on glibc that's malloc_trim(), which trims the heap of the whole process, not only this table's memory
+//without force it's refused (HASHT_RESIZE_REFUSE) unless the table is below shrink_at_percentage,
+//with force it goes to the smallest size that stays below grow_at_percentage
+//either way it forgets the size it was created or reserved with, it can shrink on its own below that from now on
+static int hasht_shrink_to_fit(struct hasht *ht, bool force) {
+#ifdef HASHT_INCREMENTAL_RESIZE
+    int rv = hasht_finish_resize(ht);
+    if (rv != HASHT_OK)
+        return rv;
+#else
+    int rv;
+#endif
+    if (!force && ht->nelements >= ht->shrink_at_lt_n)
+        return HASHT_RESIZE_REFUSE;
+    long new_nbuckets = hasht_calc_nelements_to_nbuckets(ht->nelements, ht->shrink_at_percentage, ht->grow_at_percentage);
+    if (force) {
+        //the sizes are about a power of two apart, the one below can be enough already
+        long smaller = hasht_round_nbuckets__(hasht_round_nbuckets__(new_nbuckets) / 2);
+        if (smaller > ht->nelements + 1 && ht->nelements < hasht_mul_div(smaller, ht->grow_at_percentage, 100))
+            new_nbuckets = smaller;
+    }
+    ht->min_nbuckets = HASHT_MIN_TABLESIZE;
+    if (hasht_round_nbuckets__(new_nbuckets) >= ht->nbuckets)
+        return HASHT_OK; //already as small as that
+    rv = hasht_shrink__(ht, new_nbuckets);
+    if (rv == HASHT_OK)
+        hasht_release_freed__(ht);
+    return rv;
+}
+
+#ifdef HASHT_STATS
+//copies the counters of ht to out, they can be read while other threads find in the same table
+//(a struct hasht_sharded shard, or struct hasht_swmr), but then they aren't all from the same moment
+static void hasht_get_stats(struct hasht *ht, struct hasht_stats *out) {
+    struct hasht_stats *st = &ht->stats;
+    out->finds = HASHT_STATS_LOAD(st, finds);
+    out->hits = HASHT_STATS_LOAD(st, hits);
+    out->misses = HASHT_STATS_LOAD(st, misses);
+    for (int i=0; i<HASHT_STATS_PROBE_HIST; i++)
+        out->probe_len_hist[i] = HASHT_STATS_LOAD(st, probe_len_hist[i]);
+    out->fingerprint_false_positives = HASHT_STATS_LOAD(st, fingerprint_false_positives);
+    out->tombstones_created = HASHT_STATS_LOAD(st, tombstones_created);
+    out->tombstones_reused = HASHT_STATS_LOAD(st, tombstones_reused);
+    out->tombstones_reclaimed = HASHT_STATS_LOAD(st, tombstones_reclaimed);
+    out->tombstones_purged = HASHT_STATS_LOAD(st, tombstones_purged);
+    out->resizes = HASHT_STATS_LOAD(st, resizes);
+    out->resize_bytes = HASHT_STATS_LOAD(st, resize_bytes);
+    out->resize_ns = HASHT_STATS_LOAD(st, resize_ns);
+}
+#endif
+struct hasht_iter {
+    long started_at_idx;
+    long current_idx;
+    //public fields
+    //the two members: pair->key and pair->value can be accessed directly (assuming a valid iterator)
+    struct hasht_pair_type *pair; 
+    hasht_value_type *value; //the same as &pair->value, and the only way to the value with HASHT_SOA
+};
+static struct hasht_iter hasht_mk_invalid_iter(void) {
+    struct hasht_iter iter = {HASHT_ITER_STOP, HASHT_ITER_STOP, NULL, NULL};
+    return iter;
+}
+//an iterator to the pair in bucket idx of ht
+static struct hasht_iter hasht_mk_iter(struct hasht *ht, long idx) {
+    struct hasht_iter iter = {idx, HASHT_ITER_FIRST, ht->tab + idx, hasht_value_at__(ht, idx)};
+    return iter;
+}
+static bool hasht_iter_check(struct hasht_iter *iter) {
+    HASHT_ASSERT((iter->current_idx == HASHT_ITER_STOP) || (iter->pair != NULL && iter->current_idx >= 0), "invalid iterator state");
+    return iter->current_idx != HASHT_ITER_STOP;
+}
+
+static int hasht_begin_iterator(struct hasht *ht, struct hasht_iter *iter) {
+#ifdef HASHT_INCREMENTAL_RESIZE
+    //iterating only walks one table
+    int rv = hasht_finish_resize(ht);
+    if (rv != HASHT_OK) {
+        *iter = hasht_mk_invalid_iter();
+        return rv;
+    }
+#endif
+    long next_idx = hasht_skip_to_next__(ht, 0, HASHT_ITER_FIRST, ht->nbuckets - 1);
+    if (next_idx < 0) {
         *iter = hasht_mk_invalid_iter();
         return HASHT_ITER_STOP;
     }
     iter->started_at_idx = 0;
     iter->current_idx = next_idx;
     iter->pair = ht->tab + next_idx;
+    iter->value = hasht_value_at__(ht, next_idx);
     return HASHT_OK;
 }
 
@@ -863,12 +2410,15 @@ static int hasht_iter_next(struct hasht *ht, struct hasht_iter *iter) {
     }
     iter->current_idx = next_idx;
     iter->pair = ht->tab + next_idx;
+    iter->value = hasht_value_at__(ht, next_idx);
     return HASHT_OK;
 }
-static int hasht_find(struct hasht *ht, hasht_key_type *key, struct hasht_iter *out) {
+static int hasht_find_hashed(struct hasht *ht, hasht_key_type *key, size_t full_hash, struct hasht_iter *out) {
     long found_idx;
-    size_t full_hash_unused;
-    int rv = hasht_find_pos__(ht, key, &found_idx, &full_hash_unused);
+    int rv = hasht_lookup_pos__(ht, key, full_hash, &found_idx);
+#ifdef HASHT_STATS
+    hasht_stats_found__(&ht->stats, rv);
+#endif
     if (rv == HASHT_NOT_FOUND) {
         *out = hasht_mk_invalid_iter();
         return rv;
@@ -879,20 +2429,1278 @@ static int hasht_find(struct hasht *ht, hasht_key_type *key, struct hasht_iter *
         return rv;
     }
     HASHT_ASSERT(found_idx >= 0 && found_idx < ht->nbuckets, "find pos returned invalid index");
-    struct hasht_pair_type *pair = ht->tab + found_idx;
-    *out = hasht_mk_iter(found_idx, pair);
+    *out = hasht_mk_iter(ht, found_idx);
     return HASHT_OK;
 }
-static int hasht_find_or_insert(struct hasht *ht, hasht_key_type *key, hasht_value_type *value, struct hasht_iter *out) {
+static int hasht_find(struct hasht *ht, hasht_key_type *key, struct hasht_iter *out) {
+    return hasht_find_hashed(ht, key, hasht_hash__(ht, key), out);
+}
+//removes the pair iter points to without looking its key up again, iter can come from any find or from iterating
+//when iterating, hasht_iter_next() can be called afterwards as usual, and every pair that is left is still visited exactly once
+//iter->pair is NULL until then, removing through the same iter a second time returns HASHT_NOT_FOUND
+//unlike hasht_remove(), this never shrinks the table (iterating goes on in the same buckets), hasht_shrink_to_fit() can do it afterwards
+static int hasht_remove_iter(struct hasht *ht, struct hasht_iter *iter) {
+    if (iter->current_idx == HASHT_ITER_STOP || !iter->pair)
+        return HASHT_NOT_FOUND;
+    struct hasht *in = ht;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    //the batched find can point into the old table
+    if (ht->old && iter->pair >= ht->old->tab && iter->pair < ht->old->tab + ht->old->nbuckets)
+        in = ht->old;
+#endif
+    long idx = (long) (iter->pair - in->tab);
+    if (idx < 0 || idx >= in->nbuckets || !hasht_bkt_is_occupied(in, idx))
+        return HASHT_NOT_FOUND; //already removed
+#ifdef HASHT_AGRESSIVE_CLEANUP
+    size_t full_hash = 0; //not needed
+#else
+    size_t full_hash = hasht_pair_hash__(in, iter->pair);
+#endif
+#ifdef HASHT_ROBIN_HOOD
+    //the backward shift is going to move every pair after idx (up to the end of the chain) one bucket back
+    //iterating stops when it gets back to started_at_idx, find out if the shift moves the (visited) pair there past it
+    bool iterating = in == ht && iter->current_idx != HASHT_ITER_FIRST;
+    bool crosses_start = false;
+    for (long next = hasht_idx_mod_buckets(ht, idx + 1); iterating && next != idx; next = hasht_idx_mod_buckets(ht, next + 1)) {
+        if (hasht_pr_is_empty(ht->tab + next) || ht->tab[next].probe_dist == 0)
+            break;
+        if (next == iter->started_at_idx)
+            crosses_start = true;
+    }
+#endif
+    hasht_remove_at__(in, idx, full_hash);
+#ifdef HASHT_INCREMENTAL_RESIZE
+    if (in != ht)
+        ht->nelements--; //counts the pairs of both tables
+#endif
+#ifdef HASHT_ROBIN_HOOD
+    //idx now holds the pair that came after it, make hasht_iter_next() look at idx again
+    //unless idx is the last bucket to visit, then the pair came from started_at_idx and was visited already
+    long last_idx = hasht_idx_mod_buckets(ht, iter->started_at_idx - 1);
+    if (iterating && idx == iter->started_at_idx) {
+        iter->current_idx = HASHT_ITER_FIRST;
+    }
+    else if (iterating && idx != last_idx) {
+        if (crosses_start)
+            iter->started_at_idx = last_idx; //that pair is in last_idx now, stop before it
+        iter->current_idx = hasht_idx_mod_buckets(ht, idx - 1);
+    }
+#endif
+    iter->pair = NULL;
+    iter->value = NULL;
+    return HASHT_OK;
+}
+
+static int hasht_find_or_insert_hashed(struct hasht *ht, hasht_key_type *key, size_t full_hash, hasht_value_type *value, struct hasht_iter *out) {
     long found_idx;
-    int rv = hasht_insert__(ht, key, value, &found_idx, true /*do replace*/);
+    int rv = hasht_insert_hashed__(ht, key, full_hash, value, &found_idx, true /*do replace*/);
     if (rv == HASHT_OK) {
-        struct hasht_pair_type *pair = ht->tab + found_idx;
-        *out = hasht_mk_iter(found_idx, pair);
+        *out = hasht_mk_iter(ht, found_idx);
     }
     else {
         *out = hasht_mk_invalid_iter();
     }
     return rv;
 }
+static int hasht_find_or_insert(struct hasht *ht, hasht_key_type *key, hasht_value_type *value, struct hasht_iter *out) {
+    return hasht_find_or_insert_hashed(ht, key, hasht_hash__(ht, key), value, out);
+}
+
+//looks the key up and inserts it if it's not there, in one probe
+//unlike hasht_find_or_insert() an existing value is left alone, *inserted tells which case happened
+//a new pair gets a copy of init_value, or a zeroed value when init_value is NULL
+//either way *out->value can be updated in place (until the next insert or remove), e.g. counting: (*iter.value)++
+static int hasht_try_emplace_hashed(struct hasht *ht, hasht_key_type *key, size_t full_hash, hasht_value_type *init_value, struct hasht_iter *out, bool *inserted) {
+    hasht_value_type zero;
+    if (!init_value) {
+        memset(&zero, 0, sizeof zero);
+        init_value = &zero;
+    }
+    long found_idx;
+    int rv = hasht_insert_hashed__(ht, key, full_hash, init_value, &found_idx, false /*don't replace*/);
+    *inserted = rv == HASHT_OK;
+    if (rv == HASHT_DUPLICATE_KEY)
+        rv = HASHT_OK;
+    if (rv == HASHT_OK)
+        *out = hasht_mk_iter(ht, found_idx);
+    else
+        *out = hasht_mk_invalid_iter();
+    return rv;
+}
+static int hasht_try_emplace(struct hasht *ht, hasht_key_type *key, hasht_value_type *init_value, struct hasht_iter *out, bool *inserted) {
+    return hasht_try_emplace_hashed(ht, key, hasht_hash__(ht, key), init_value, out, inserted);
+}
+
+#ifdef HASHT_PROBE
+static size_t hasht_probe_hash__(struct hasht *ht, hasht_probe_type *probe) {
+#ifdef HASHT_DATA_ARG
+    return hasht_probe_hash(ht->userdata, probe);
+#else
+    (void) ht;
+    return hasht_probe_hash(probe);
+#endif
+}
+//same as hasht_find(), but the key is looked up by a probe, no hasht_key_type is ever built
+static int hasht_find_as(struct hasht *ht, hasht_probe_type *probe, struct hasht_iter *out) {
+    long found_idx;
+    int rv = hasht_lookup_pos_as__(ht, NULL, probe, hasht_probe_hash__(ht, probe), &found_idx);
+#ifdef HASHT_STATS
+    hasht_stats_found__(&ht->stats, rv);
+#endif
+    if (rv != HASHT_OK) {
+        *out = hasht_mk_invalid_iter();
+        return rv;
+    }
+    HASHT_ASSERT(found_idx >= 0 && found_idx < ht->nbuckets, "find pos returned invalid index");
+    *out = hasht_mk_iter(ht, found_idx);
+    return HASHT_OK;
+}
+//same as hasht_remove(), by a probe
+static int hasht_remove_as(struct hasht *ht, hasht_probe_type *probe) {
+    size_t full_hash = hasht_probe_hash__(ht, probe);
+    long found_idx;
+    int rv = hasht_lookup_pos_as__(ht, NULL, probe, full_hash, &found_idx);
+    if (rv != HASHT_OK)
+        return rv;
+    HASHT_ASSERT(hasht_bkt_is_occupied(ht, found_idx), "find pos returned an index of a deleted/empty element");
+    hasht_remove_at__(ht, found_idx, full_hash);
+    hasht_if_needed_try_resize(ht, HASHT_HINT_DELETING);
+    return HASHT_OK;
+}
+#endif // HASHT_PROBE
+
+//looks up nkeys keys at once, the result for keys[i] goes to out[i] (pair is NULL if not found)
+//the keys of each group of HASHT_BATCH_WIDTH are hashed and their buckets prefetched before any of them is probed,
+//so the cache misses overlap instead of happening one after the other
+//nothing is moved while the batch is resolved, so all results stay valid until the table is modified
+//(with HASHT_INCREMENTAL_RESIZE that means a result can point to a pair in the old table, don't iterate from it)
+//returns HASHT_OK, or an error if the table is in an invalid state
+static int hasht_find_batch(struct hasht *ht, hasht_key_type *keys, long nkeys, struct hasht_iter *out) {
+    size_t hashes[HASHT_BATCH_WIDTH];
+    for (long base=0; base<nkeys; base += HASHT_BATCH_WIDTH) {
+        long n = nkeys - base < HASHT_BATCH_WIDTH ? nkeys - base : HASHT_BATCH_WIDTH;
+#ifdef HASHT_INCREMENTAL_RESIZE
+        int step_rv = hasht_migrate_step__(ht, HASHT_INCREMENTAL_STEP); //once per group, not per key
+        if (step_rv != HASHT_OK)
+            return step_rv;
+#endif
+        for (long i=0; i<n; i++) {
+            hashes[i] = hasht_hash__(ht, keys + base + i);
+            long idx = hasht_integer_mod_buckets(ht, hashes[i]);
+#ifdef HASHT_CTRL_BYTES
+            HASHT_PREFETCH(ht->ctrl + idx);
+#endif
+            HASHT_PREFETCH(ht->tab + idx);
+        }
+        for (long i=0; i<n; i++) {
+            long found_idx;
+            struct hasht *found_in = ht;
+            int rv = hasht_find_pos_hashed__(ht, keys + base + i, hashes[i], &found_idx);
+#ifdef HASHT_INCREMENTAL_RESIZE
+            if (rv == HASHT_NOT_FOUND && ht->old) {
+                found_in = ht->old;
+                rv = hasht_find_pos_hashed__(ht->old, keys + base + i, hashes[i], &found_idx);
+            }
+#endif
+#ifdef HASHT_STATS
+            hasht_stats_found__(&ht->stats, rv);
+#endif
+            if (rv == HASHT_OK) {
+                out[base + i] = hasht_mk_iter(found_in, found_idx);
+            }
+            else {
+                out[base + i] = hasht_mk_invalid_iter();
+                if (rv != HASHT_NOT_FOUND)
+                    return rv;
+            }
+        }
+    }
+    return HASHT_OK;
+}
+
+//same as hasht_find_batch(), results[i] is set to HASHT_OK if keys[i] is in the table and HASHT_NOT_FOUND otherwise
+static int hasht_contains_batch(struct hasht *ht, hasht_key_type *keys, long nkeys, int *results) {
+    struct hasht_iter iters[HASHT_BATCH_WIDTH];
+    for (long base=0; base<nkeys; base += HASHT_BATCH_WIDTH) {
+        long n = nkeys - base < HASHT_BATCH_WIDTH ? nkeys - base : HASHT_BATCH_WIDTH;
+        int rv = hasht_find_batch(ht, keys + base, n, iters);
+        if (rv != HASHT_OK)
+            return rv;
+        for (long i=0; i<n; i++)
+            results[base + i] = iters[i].pair ? HASHT_OK : HASHT_NOT_FOUND;
+    }
+    return HASHT_OK;
+}
+
+//runs fn(ctx, t) for t in [0, nthreads), on nthreads threads if HASHT_THREADS is defined and one after the other otherwise
+typedef void (*hasht_worker_fptr)(void *ctx, long t);
+struct hasht_worker_arg__ {
+    hasht_worker_fptr fn;
+    void *ctx;
+    long t;
+};
+#ifdef HASHT_THREADS
+static void *hasht_worker_main__(void *arg) {
+    struct hasht_worker_arg__ *warg = (struct hasht_worker_arg__ *) arg;
+    warg->fn(warg->ctx, warg->t);
+    return NULL;
+}
+#endif
+static int hasht_run_workers__(struct hasht *ht, long nthreads, hasht_worker_fptr fn, void *ctx) {
+#ifdef HASHT_THREADS
+    if (nthreads > 1) {
+        struct hasht_worker_arg__ *args = ht->memfuncs.alloc(sizeof(*args) * nthreads, ht->userdata);
+        pthread_t *threads = ht->memfuncs.alloc(sizeof(*threads) * nthreads, ht->userdata);
+        bool *started = ht->memfuncs.alloc(sizeof(*started) * nthreads, ht->userdata);
+        if (!args || !threads || !started) {
+            ht->memfuncs.free(args, ht->userdata);
+            ht->memfuncs.free(threads, ht->userdata);
+            ht->memfuncs.free(started, ht->userdata);
+            return HASHT_ALLOC_ERR;
+        }
+        for (long t=1; t<nthreads; t++) {
+            struct hasht_worker_arg__ warg = { fn, ctx, t };
+            args[t] = warg;
+            started[t] = pthread_create(threads + t, NULL, hasht_worker_main__, args + t) == 0;
+        }
+        fn(ctx, 0);
+        for (long t=1; t<nthreads; t++) {
+            if (started[t])
+                pthread_join(threads[t], NULL);
+            else
+                fn(ctx, t); //couldn't start a thread, do its share here
+        }
+        ht->memfuncs.free(args, ht->userdata);
+        ht->memfuncs.free(threads, ht->userdata);
+        ht->memfuncs.free(started, ht->userdata);
+        return HASHT_OK;
+    }
+#else
+    (void) ht;
+#endif
+    for (long t=0; t<nthreads; t++)
+        fn(ctx, t);
+    return HASHT_OK;
+}
+
+struct hasht_build_ctx__ {
+    struct hasht *ht;
+    //the input is either the arrays keys and values, or the occupied buckets of src (then keys and values are NULL)
+    hasht_key_type *keys;
+    hasht_value_type *values;
+    struct hasht *src;
+    long n; //length of the arrays, or src->nbuckets
+    long nparts; //one partition (a range of buckets) per thread
+    long part_sz;
+    size_t *hashes;
+    long *part_counts; //[thread * nparts + part], then turned into offsets into order
+    long *order;      //input indices, grouped by partition and in input order within each partition
+    long *part_placed; //per partition results
+    long *part_dups;
+    long *part_spilled; //the first part_spilled[p] entries of the partition in order are left for the serial pass
+};
+
+static bool hasht_build_has__(struct hasht_build_ctx__ *ctx, long i) {
+    return !ctx->src || hasht_bkt_is_occupied(ctx->src, i);
+}
+static hasht_key_type *hasht_build_key__(struct hasht_build_ctx__ *ctx, long i) {
+    return ctx->src ? &ctx->src->tab[i].key : ctx->keys + i;
+}
+static hasht_value_type *hasht_build_value__(struct hasht_build_ctx__ *ctx, long i) {
+    return ctx->src ? hasht_value_at__(ctx->src, i) : ctx->values + i;
+}
+
+static void hasht_build_slice__(struct hasht_build_ctx__ *ctx, long t, long *begin, long *end) {
+    *begin = hasht_mul_div(ctx->n, t, ctx->nparts);
+    *end = hasht_mul_div(ctx->n, t + 1, ctx->nparts);
+}
+//hashes a slice of the input, and counts how many of its entries fall in each partition
+static void hasht_build_hash_phase__(void *vctx, long t) {
+    struct hasht_build_ctx__ *ctx = (struct hasht_build_ctx__ *) vctx;
+    long begin, end;
+    hasht_build_slice__(ctx, t, &begin, &end);
+    long *counts = ctx->part_counts + t * ctx->nparts;
+    for (long i=begin; i<end; i++) {
+        if (!hasht_build_has__(ctx, i))
+            continue;
+        ctx->hashes[i] = ctx->src ? hasht_pair_hash__(ctx->src, ctx->src->tab + i) : hasht_hash__(ctx->ht, ctx->keys + i);
+        counts[hasht_integer_mod_buckets(ctx->ht, ctx->hashes[i]) / ctx->part_sz]++;
+    }
+}
+//writes the indices of a slice of the input to their partitions
+static void hasht_build_scatter_phase__(void *vctx, long t) {
+    struct hasht_build_ctx__ *ctx = (struct hasht_build_ctx__ *) vctx;
+    long begin, end;
+    hasht_build_slice__(ctx, t, &begin, &end);
+    long *offsets = ctx->part_counts + t * ctx->nparts;
+    for (long i=begin; i<end; i++) {
+        if (hasht_build_has__(ctx, i))
+            ctx->order[offsets[hasht_integer_mod_buckets(ctx->ht, ctx->hashes[i]) / ctx->part_sz]++] = i;
+    }
+}
+//places the entries of partition p, without ever touching a bucket outside of the partition
+//an entry whose probe sequence reaches the end of the partition is left for the serial pass
+static void hasht_build_place_phase__(void *vctx, long p) {
+    struct hasht_build_ctx__ *ctx = (struct hasht_build_ctx__ *) vctx;
+    struct hasht *ht = ctx->ht;
+    long part_end = (p + 1) * ctx->part_sz < ht->nbuckets ? (p + 1) * ctx->part_sz : ht->nbuckets;
+    long order_begin = p == 0 ? 0 : ctx->part_counts[(ctx->nparts - 1) * ctx->nparts + p - 1];
+    long order_end = ctx->part_counts[(ctx->nparts - 1) * ctx->nparts + p];
+    long placed = 0, dups = 0, spilled = 0;
+    for (long o=order_begin; o<order_end; o++) {
+        if (o + HASHT_BATCH_WIDTH < order_end) {
+            //the destinations are scattered over the partition, start loading them early
+            long ahead = hasht_integer_mod_buckets(ht, ctx->hashes[ctx->order[o + HASHT_BATCH_WIDTH]]);
+#ifdef HASHT_CTRL_BYTES
+            HASHT_PREFETCH(ht->ctrl + ahead);
+#endif
+            HASHT_PREFETCH(ht->tab + ahead);
+        }
+        long i = ctx->order[o];
+        size_t full_hash = ctx->hashes[i];
+        hasht_key_type *key = hasht_build_key__(ctx, i);
+#ifdef HASHT_CTRL_BYTES
+        unsigned int partial_hash = 0; //compared against the full hash or not at all
+#else
+        unsigned int partial_hash = hasht_hash_to_partial_hash(full_hash);
+#endif
+        long idx = hasht_integer_mod_buckets(ht, full_hash);
+        while (1) {
+            if (idx >= part_end) {
+                ctx->order[order_begin + spilled++] = i;
+                break;
+            }
+            if (hasht_bkt_is_empty(ht, idx)) {
+                hasht_set_pair_at_pos__(ht, full_hash, key, hasht_build_value__(ctx, i), idx);
+                placed++;
+                break;
+            }
+            //the keys of a source table are all distinct, no need to compare them
+#ifdef HASHT_CTRL_BYTES
+            if (!ctx->src && ht->ctrl[idx] == hasht_hash_to_ctrl(full_hash) && hasht_cmp(ht, key, full_hash, partial_hash, ht->tab + idx) == 0) {
+#else
+            if (!ctx->src && hasht_cmp(ht, key, full_hash, partial_hash, ht->tab + idx) == 0) {
+#endif
+                dups++; //the first one wins, same as inserting one by one
+                break;
+            }
+            idx++;
+        }
+    }
+    ctx->part_placed[p] = placed;
+    ctx->part_dups[p] = dups;
+    ctx->part_spilled[p] = spilled;
+}
+
+//fills ht, which must be empty and already sized for all of the input, using ctx->nparts threads
+//returns the number of duplicates through ndups_out
+static int hasht_build_run__(struct hasht_build_ctx__ *ctx, long nentries, long *ndups_out) {
+    struct hasht *ht = ctx->ht;
+    int rv;
+    long ndups = 0;
+    ctx->hashes = ht->memfuncs.alloc(sizeof(size_t) * (ctx->n ? ctx->n : 1), ht->userdata);
+    ctx->order = ht->memfuncs.alloc(sizeof(long) * (nentries ? nentries : 1), ht->userdata);
+    ctx->part_counts = ht->memfuncs.alloc(sizeof(long) * ctx->nparts * (ctx->nparts + 3), ht->userdata);
+    if (!ctx->hashes || !ctx->order || !ctx->part_counts) {
+        rv = HASHT_ALLOC_ERR;
+        goto cleanup;
+    }
+    memset(ctx->part_counts, 0, sizeof(long) * ctx->nparts * (ctx->nparts + 3));
+    ctx->part_placed  = ctx->part_counts + ctx->nparts * ctx->nparts;
+    ctx->part_dups    = ctx->part_placed + ctx->nparts;
+    ctx->part_spilled = ctx->part_dups + ctx->nparts;
+
+    rv = hasht_run_workers__(ht, ctx->nparts, hasht_build_hash_phase__, ctx);
+    if (rv != HASHT_OK)
+        goto cleanup;
+
+#ifdef HASHT_ROBIN_HOOD
+    //placing has to displace entries, which can cross into any partition, so only the hashing is done in parallel
+    for (long i=0; i<ctx->n; i++) {
+        if (!hasht_build_has__(ctx, i))
+            continue;
+        long idx_unused;
+        rv = hasht_insert_hashed__(ht, hasht_build_key__(ctx, i), ctx->hashes[i], hasht_build_value__(ctx, i), &idx_unused, false);
+        if (rv == HASHT_DUPLICATE_KEY)
+            ndups++;
+        else if (rv != HASHT_OK)
+            goto cleanup;
+    }
+#else
+    //counts to offsets, partition major, so that each partition gets its entries in input order
+    long sum = 0;
+    for (long p=0; p<ctx->nparts; p++) {
+        for (long t=0; t<ctx->nparts; t++) {
+            long count = ctx->part_counts[t * ctx->nparts + p];
+            ctx->part_counts[t * ctx->nparts + p] = sum;
+            sum += count;
+        }
+    }
+    HASHT_ASSERT(sum == nentries, "");
+    rv = hasht_run_workers__(ht, ctx->nparts, hasht_build_scatter_phase__, ctx);
+    if (rv != HASHT_OK)
+        goto cleanup;
+    //the last thread's offsets are now the end of each partition
+    rv = hasht_run_workers__(ht, ctx->nparts, hasht_build_place_phase__, ctx);
+    if (rv != HASHT_OK)
+        goto cleanup;
+
+    for (long p=0; p<ctx->nparts; p++) {
+        ht->nelements += ctx->part_placed[p];
+        ndups += ctx->part_dups[p];
+    }
+    //whatever ran off the end of its partition, in order, through the normal insertion path
+    for (long p=0; p<ctx->nparts; p++) {
+        long order_begin = p == 0 ? 0 : ctx->part_counts[(ctx->nparts - 1) * ctx->nparts + p - 1];
+        for (long o=order_begin; o<order_begin + ctx->part_spilled[p]; o++) {
+            long i = ctx->order[o];
+            long idx_unused;
+            rv = hasht_insert_hashed__(ht, hasht_build_key__(ctx, i), ctx->hashes[i], hasht_build_value__(ctx, i), &idx_unused, false);
+            if (rv == HASHT_DUPLICATE_KEY)
+                ndups++;
+            else if (rv != HASHT_OK)
+                goto cleanup;
+        }
+    }
+#endif // HASHT_ROBIN_HOOD
+    HASHT_ASSERT(ht->nelements + ndups == nentries, "");
+    HASHT_ASSERT(hasht_dbg_sanity_heavy(ht), "");
+    rv = HASHT_OK;
+
+cleanup:
+    *ndups_out = ndups;
+    ht->memfuncs.free(ctx->hashes, ht->userdata);
+    ht->memfuncs.free(ctx->order, ht->userdata);
+    ht->memfuncs.free(ctx->part_counts, ht->userdata);
+    return rv;
+}
+
+static void hasht_build_ctx_init__(struct hasht_build_ctx__ *ctx, struct hasht *ht, long n, long nthreads) {
+    memset(ctx, 0, sizeof *ctx);
+    ctx->ht = ht;
+    ctx->n = n;
+    nthreads = nthreads < 1 ? 1 : nthreads;
+    ctx->nparts = nthreads < ht->nbuckets ? nthreads : ht->nbuckets;
+    ctx->part_sz = (ht->nbuckets + ctx->nparts - 1) / ctx->nparts;
+}
+
+//fills an empty table with n pairs (keys[i], values[i]), using up to nthreads threads (if HASHT_THREADS is defined)
+//the table is sized once for n elements, keys are hashed in parallel and each thread places the keys of its own range of buckets
+//hasht_hash() and hasht_key_eq_cmp() are called from several threads at once
+//if a key appears more than once, the first one is kept and HASHT_DUPLICATE_KEY is returned (the table is still valid and filled)
+static int hasht_build_from_arrays(struct hasht *ht, hasht_key_type *keys, hasht_value_type *values, long n, long nthreads) {
+    if (ht->nelements != 0 || n < 0)
+        return HASHT_INVALID_REQ_SZ;
+
+    //size it once
+    struct hasht new_ht;
+    int rv = hasht_init_copy_settings_sz__(&new_ht, n, -1, false, ht);
+    if (rv != HASHT_OK)
+        return rv;
+#ifdef HASHT_STR_KEYS
+    hasht_str_arena_move__(&new_ht, ht);
+#endif
+    hasht_deinit(ht);
+    memcpy(ht, &new_ht, sizeof *ht);
+
+#ifdef HASHT_STR_KEYS
+    //copying the strings into the arena is serial, so is inserting them
+    (void) nthreads;
+    long ndups = 0;
+    for (long i=0; i<n; i++) {
+        long idx_unused;
+        rv = hasht_insert_hashed__(ht, keys + i, hasht_hash__(ht, keys + i), values + i, &idx_unused, false);
+        if (rv == HASHT_DUPLICATE_KEY)
+            ndups++;
+        else if (rv != HASHT_OK)
+            return rv;
+    }
+    return ndups ? HASHT_DUPLICATE_KEY : HASHT_OK;
+#else
+
+    struct hasht_build_ctx__ ctx;
+    hasht_build_ctx_init__(&ctx, ht, n, nthreads);
+    ctx.keys = keys;
+    ctx.values = values;
+    long ndups;
+    rv = hasht_build_run__(&ctx, n, &ndups);
+    if (rv != HASHT_OK)
+        return rv;
+    return ndups ? HASHT_DUPLICATE_KEY : HASHT_OK;
+#endif // HASHT_STR_KEYS
+}
+
+//copies every pair of src into dst (empty, sized to hold them without growing) with dst->resize_nthreads threads
+//same partitioning as hasht_build_from_arrays(), reading the old buckets instead of arrays
+static int hasht_copy_all_to_parallel__(struct hasht *dst, struct hasht *src) {
+    struct hasht_build_ctx__ ctx;
+    hasht_build_ctx_init__(&ctx, dst, src->nbuckets, dst->resize_nthreads);
+    ctx.src = src;
+    long ndups;
+    int rv = hasht_build_run__(&ctx, src->nelements, &ndups);
+    HASHT_ASSERT(rv != HASHT_OK || ndups == 0, "duplicate key in a table");
+    return rv;
+}
+
+#ifdef HASHT_THREADS
+//a front end that splits the keys between nshards independent tables, each behind its own lock
+//threads that work on different shards never wait for each other
+//the shard comes from the high bits of the remixed hash, and every shard still uses the whole hash for its buckets
+//with HASHT_SHARDED_RWLOCK each lock is a reader-writer lock and finds only take it for reading
+struct hasht_shard__ {
+    struct hasht ht;
+#ifdef HASHT_SHARDED_RWLOCK
+    pthread_rwlock_t lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+//padded so that two shards (and their locks) never share a cache line
+union hasht_shard_padded__ {
+    struct hasht_shard__ s;
+    char pad[(sizeof(struct hasht_shard__) + HASHT_CACHE_LINE - 1) / HASHT_CACHE_LINE * HASHT_CACHE_LINE];
+};
+struct hasht_sharded {
+    union hasht_shard_padded__ *shards; //aligned to HASHT_CACHE_LINE, points inside mem
+    void *mem;
+    long nshards; //power of two
+    long nshards_po2;
+    struct hasht_alloc_funcs memfuncs;
+    void *userdata;
+};
+
+static void hasht_shard_lock_read__(struct hasht_shard__ *shard) {
+#ifdef HASHT_SHARDED_RWLOCK
+    pthread_rwlock_rdlock(&shard->lock);
+#else
+    pthread_mutex_lock(&shard->lock);
+#endif
+}
+static void hasht_shard_lock_write__(struct hasht_shard__ *shard) {
+#ifdef HASHT_SHARDED_RWLOCK
+    pthread_rwlock_wrlock(&shard->lock);
+#else
+    pthread_mutex_lock(&shard->lock);
+#endif
+}
+static void hasht_shard_unlock__(struct hasht_shard__ *shard) {
+#ifdef HASHT_SHARDED_RWLOCK
+    pthread_rwlock_unlock(&shard->lock);
+#else
+    pthread_mutex_unlock(&shard->lock);
+#endif
+}
+static int hasht_shard_lock_init__(struct hasht_shard__ *shard) {
+#ifdef HASHT_SHARDED_RWLOCK
+    return pthread_rwlock_init(&shard->lock, NULL);
+#else
+    return pthread_mutex_init(&shard->lock, NULL);
+#endif
+}
+static void hasht_shard_lock_destroy__(struct hasht_shard__ *shard) {
+#ifdef HASHT_SHARDED_RWLOCK
+    pthread_rwlock_destroy(&shard->lock);
+#else
+    pthread_mutex_destroy(&shard->lock);
+#endif
+}
+
+//the shard a hash belongs to
+//the multiplier differs from the one HASHT_POW2 uses, so that the keys of a shard still spread over all of its buckets
+static struct hasht_shard__ *hasht_sharded_pick__(struct hasht_sharded *sh, size_t full_hash) {
+    if (sh->nshards_po2 == 0)
+        return &sh->shards[0].s;
+    uint64_t mixed = ((uint64_t) full_hash ^ ((uint64_t) full_hash >> 32)) * 0xD6E8FEB86659FD93LLU;
+    return &sh->shards[mixed >> (64 - sh->nshards_po2)].s;
+}
+
+static size_t hasht_sharded_hash__(struct hasht_sharded *sh, hasht_key_type *key) {
+    //every shard has the same userdata
+    return hasht_hash__(&sh->shards[0].s.ht, key);
+}
+
+static void hasht_sharded_deinit(struct hasht_sharded *sh) {
+    for (long i=0; i<sh->nshards; i++) {
+        hasht_deinit(&sh->shards[i].s.ht);
+        hasht_shard_lock_destroy__(&sh->shards[i].s);
+    }
+    sh->memfuncs.free(sh->mem, sh->userdata);
+    sh->mem = NULL;
+    sh->shards = NULL;
+    sh->nshards = 0;
+}
+
+//nshards is rounded up to a power of two, initial_nelements is for the whole table
+static int hasht_sharded_init_ex(struct hasht_sharded *sh,
+                        long nshards,
+                        long initial_nelements,
+                        hasht_malloc_fptr alloc,
+                        hasht_realloc_fptr realloc,
+                        hasht_free_fptr free,
+                        void *userdata,
+                        long shrink_at_percentage,
+                        long grow_at_percentage)
+{
+    const struct hasht_alloc_funcs memfuncs = { alloc, realloc, free, NULL, }; //each shard picks its own zalloc
+    sh->memfuncs = memfuncs;
+    sh->userdata = userdata;
+    sh->nshards_po2 = 0;
+    while ((1L << sh->nshards_po2) < nshards && sh->nshards_po2 < 16)
+        sh->nshards_po2++;
+    long n = 1L << sh->nshards_po2;
+    sh->mem = alloc(sizeof(union hasht_shard_padded__) * n + HASHT_CACHE_LINE, userdata);
+    if (!sh->mem)
+        return HASHT_ALLOC_ERR;
+    sh->shards = (union hasht_shard_padded__ *) (((uintptr_t) sh->mem + HASHT_CACHE_LINE - 1) & ~(uintptr_t) (HASHT_CACHE_LINE - 1));
+    sh->nshards = 0; //number of shards that were initialized so far, for cleaning up
+    for (long i=0; i<n; i++) {
+        struct hasht_shard__ *shard = &sh->shards[i].s;
+        int rv = hasht_init_ex(&shard->ht, initial_nelements / n, alloc, realloc, free, userdata,
+                               shrink_at_percentage, grow_at_percentage);
+        if (rv == HASHT_OK && hasht_shard_lock_init__(shard) != 0) {
+            hasht_deinit(&shard->ht);
+            rv = HASHT_ALLOC_ERR;
+        }
+        if (rv != HASHT_OK) {
+            hasht_sharded_deinit(sh);
+            return rv;
+        }
+        sh->nshards++;
+    }
+    return HASHT_OK;
+}
+
+static int hasht_sharded_init(struct hasht_sharded *sh, long nshards, long initial_nelements) {
+    return hasht_sharded_init_ex(sh, //struct hasht_sharded *sh,
+                        nshards, //long nshards,
+                        initial_nelements, //long initial_nelements,
+                        hasht_def_malloc,//hasht_malloc_fptr alloc,
+                        hasht_def_realloc,//hasht_realloc_fptr realloc,
+                        hasht_def_free,// hasht_free_fptr free,
+                        NULL, //void *userdata,
+                        20, //long shrink_at_percentage,
+                        60 //long grow_at_percentage)
+                        );
+}
+
+//all of the following can be called from any number of threads at once
+//hasht_hash() is called outside of the locks, hasht_key_eq_cmp() inside
+
+static int hasht_sharded_insert(struct hasht_sharded *sh, hasht_key_type *key, hasht_value_type *value) {
+    size_t full_hash = hasht_sharded_hash__(sh, key);
+    struct hasht_shard__ *shard = hasht_sharded_pick__(sh, full_hash);
+    long idx_unused;
+    hasht_shard_lock_write__(shard);
+    int rv = hasht_insert_hashed__(&shard->ht, key, full_hash, value, &idx_unused, false /*dont replace*/);
+    hasht_shard_unlock__(shard);
+    return rv;
+}
+
+//same as hasht_sharded_insert(), but an existing value is replaced
+static int hasht_sharded_insert_or_replace(struct hasht_sharded *sh, hasht_key_type *key, hasht_value_type *value) {
+    size_t full_hash = hasht_sharded_hash__(sh, key);
+    struct hasht_shard__ *shard = hasht_sharded_pick__(sh, full_hash);
+    long idx_unused;
+    hasht_shard_lock_write__(shard);
+    int rv = hasht_insert_hashed__(&shard->ht, key, full_hash, value, &idx_unused, true /*do replace*/);
+    hasht_shard_unlock__(shard);
+    return rv;
+}
+
+//the value is copied to value_out (if not NULL), a pointer into the table would be unsafe once the lock is released
+//this doesn't move anything, even with HASHT_INCREMENTAL_RESIZE, so a read lock is enough
+static int hasht_sharded_find(struct hasht_sharded *sh, hasht_key_type *key, hasht_value_type *value_out) {
+    size_t full_hash = hasht_sharded_hash__(sh, key);
+    struct hasht_shard__ *shard = hasht_sharded_pick__(sh, full_hash);
+    hasht_shard_lock_read__(shard);
+    struct hasht *found_in = &shard->ht;
+    long found_idx;
+    int rv = hasht_find_pos_hashed__(found_in, key, full_hash, &found_idx);
+#ifdef HASHT_INCREMENTAL_RESIZE
+    if (rv == HASHT_NOT_FOUND && found_in->old) {
+        found_in = found_in->old;
+        rv = hasht_find_pos_hashed__(found_in, key, full_hash, &found_idx);
+    }
+#endif
+#ifdef HASHT_STATS
+    hasht_stats_found__(&shard->ht.stats, rv);
+#endif
+    if (rv == HASHT_OK && value_out)
+        memcpy(value_out, hasht_value_at__(found_in, found_idx), sizeof *value_out);
+    hasht_shard_unlock__(shard);
+    return rv;
+}
+
+static int hasht_sharded_remove(struct hasht_sharded *sh, hasht_key_type *key) {
+    size_t full_hash = hasht_sharded_hash__(sh, key);
+    struct hasht_shard__ *shard = hasht_sharded_pick__(sh, full_hash);
+    hasht_shard_lock_write__(shard);
+    //shrinks the shard like hasht_remove() does, nobody else can look at it while the write lock is held
+    int rv = hasht_remove_hashed(&shard->ht, key, full_hash);
+    hasht_shard_unlock__(shard);
+    return rv;
+}
+
+//only exact while no other thread is modifying the table
+static long hasht_sharded_nelements(struct hasht_sharded *sh) {
+    long n = 0;
+    for (long i=0; i<sh->nshards; i++) {
+        struct hasht_shard__ *shard = &sh->shards[i].s;
+        hasht_shard_lock_read__(shard);
+        n += shard->ht.nelements;
+        hasht_shard_unlock__(shard);
+    }
+    return n;
+}
+
+#ifdef HASHT_STATS
+//the counters of all shards added up
+static void hasht_sharded_get_stats(struct hasht_sharded *sh, struct hasht_stats *out) {
+    memset(out, 0, sizeof *out);
+    for (long i=0; i<sh->nshards; i++) {
+        struct hasht_shard__ *shard = &sh->shards[i].s;
+        struct hasht_stats st;
+        //resizing rewrites shard->ht (stats included), finds only add to it
+        hasht_shard_lock_read__(shard);
+        hasht_get_stats(&shard->ht, &st);
+        hasht_shard_unlock__(shard);
+        out->finds += st.finds;
+        out->hits += st.hits;
+        out->misses += st.misses;
+        for (int j=0; j<HASHT_STATS_PROBE_HIST; j++)
+            out->probe_len_hist[j] += st.probe_len_hist[j];
+        out->fingerprint_false_positives += st.fingerprint_false_positives;
+        out->tombstones_created += st.tombstones_created;
+        out->tombstones_reused += st.tombstones_reused;
+        out->tombstones_reclaimed += st.tombstones_reclaimed;
+        out->tombstones_purged += st.tombstones_purged;
+        out->resizes += st.resizes;
+        out->resize_bytes += st.resize_bytes;
+        out->resize_ns += st.resize_ns;
+    }
+}
+#endif
+#endif // HASHT_THREADS
+
+#ifdef HASHT_SWMR
+//one writer thread and any number of reader threads, readers never take a lock and never wait for each other
+//  - changes to the buckets are wrapped in a sequence counter (a seqlock), a reader that overlapped one retries
+//  - resizing (growing, and shrinking after removes) builds a new table next to the current one,
+//    which readers keep using until the new one is published
+//  - a table that was replaced is only freed once every reader that could still see it has left (epochs)
+//a reader can run hasht_key_eq_cmp() on a key that is being overwritten, it can see part of the old key and part
+//of the new one (the result is thrown away): the compare must not crash or loop on such a torn key,
+//so memory that keys point to must stay readable until hasht_swmr_deinit(), or the key type must not be a pointer
+//readers use plain loads on buckets the writer is storing to, in C11 terms that's a data race like in any seqlock,
+//it relies on the fences around the loads and on the compiler (gcc, clang) not inventing loads that aren't there
+#ifndef HASHT_SWMR_MAX_READERS
+    #define HASHT_SWMR_MAX_READERS 64
+#endif
+//a hint to the cpu that this is a spin loop, so it doesn't flood the memory bus while the writer works
+static inline void hasht_swmr_cpu_relax__(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+union hasht_swmr_reader_slot__ {
+    struct {
+        _Atomic unsigned long epoch; //the epoch the reader entered in, 0 while it isn't reading
+        _Atomic bool in_use;
+    } s;
+    char pad[HASHT_CACHE_LINE]; //readers only write to their own slot, don't share the cache line
+};
+//a replaced table, freed once no reader is in an epoch older than epoch
+struct hasht_swmr_retired__ {
+    struct hasht *ht;
+    unsigned long epoch;
+    struct hasht_swmr_retired__ *next;
+};
+struct hasht_swmr {
+    _Atomic(struct hasht *) cur; //only the writer changes it, readers load it once per attempt
+    _Atomic unsigned long seq; //odd while the writer is changing buckets of cur
+    _Atomic unsigned long epoch; //starts at 1
+    struct hasht_swmr_retired__ *retired;
+    union hasht_swmr_reader_slot__ readers[HASHT_SWMR_MAX_READERS];
+};
+
+static struct hasht *hasht_swmr_table__(struct hasht_swmr *sw) {
+    return atomic_load_explicit(&sw->cur, memory_order_relaxed); //only for the writer
+}
+
+static int hasht_swmr_init_ex(struct hasht_swmr *sw,
+                        long initial_nelements,
+                        hasht_malloc_fptr alloc,
+                        hasht_realloc_fptr realloc,
+                        hasht_free_fptr free,
+                        void *userdata,
+                        long shrink_at_percentage,
+                        long grow_at_percentage)
+{
+    struct hasht *ht = alloc(sizeof *ht, userdata);
+    if (!ht)
+        return HASHT_ALLOC_ERR;
+    int rv = hasht_init_ex(ht, initial_nelements, alloc, realloc, free, userdata, shrink_at_percentage, grow_at_percentage);
+    if (rv != HASHT_OK) {
+        free(ht, userdata);
+        return rv;
+    }
+    atomic_init(&sw->cur, ht);
+    atomic_init(&sw->seq, 0);
+    atomic_init(&sw->epoch, 1);
+    sw->retired = NULL;
+    for (int i=0; i<HASHT_SWMR_MAX_READERS; i++) {
+        atomic_init(&sw->readers[i].s.epoch, 0);
+        atomic_init(&sw->readers[i].s.in_use, false);
+    }
+    return HASHT_OK;
+}
+
+static int hasht_swmr_init(struct hasht_swmr *sw, long initial_nelements) {
+    return hasht_swmr_init_ex(sw, //struct hasht_swmr *sw,
+                        initial_nelements, //long initial_nelements,
+                        hasht_def_malloc,//hasht_malloc_fptr alloc,
+                        hasht_def_realloc,//hasht_realloc_fptr realloc,
+                        hasht_def_free,// hasht_free_fptr free,
+                        NULL, //void *userdata,
+                        20, //long shrink_at_percentage,
+                        60 //long grow_at_percentage)
+                        );
+}
 
+static void hasht_swmr_free_table__(struct hasht *ht) {
+    struct hasht_alloc_funcs memfuncs = ht->memfuncs;
+    void *userdata = ht->userdata;
+    hasht_deinit(ht);
+    memfuncs.free(ht, userdata);
+}
+
+//no reader may be registered anymore
+static void hasht_swmr_deinit(struct hasht_swmr *sw) {
+    struct hasht *ht = hasht_swmr_table__(sw);
+    while (sw->retired) {
+        struct hasht_swmr_retired__ *next = sw->retired->next;
+        hasht_swmr_free_table__(sw->retired->ht);
+        ht->memfuncs.free(sw->retired, ht->userdata);
+        sw->retired = next;
+    }
+    hasht_swmr_free_table__(ht);
+    atomic_store(&sw->cur, NULL);
+}
+
+//reader side
+
+//every reader thread needs its own id, returns it or a negative value if all HASHT_SWMR_MAX_READERS are taken
+static int hasht_swmr_reader_register(struct hasht_swmr *sw) {
+    for (int i=0; i<HASHT_SWMR_MAX_READERS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&sw->readers[i].s.in_use, &expected, true))
+            return i;
+    }
+    return HASHT_ALLOC_ERR;
+}
+static void hasht_swmr_reader_unregister(struct hasht_swmr *sw, int reader_id) {
+    atomic_store(&sw->readers[reader_id].s.epoch, 0);
+    atomic_store(&sw->readers[reader_id].s.in_use, false);
+}
+
+//the value is copied to value_out (if not NULL), the pair itself can change as soon as this returns
+static int hasht_swmr_find(struct hasht_swmr *sw, int reader_id, hasht_key_type *key, hasht_value_type *value_out) {
+    _Atomic unsigned long *my_epoch = &sw->readers[reader_id].s.epoch;
+    //nothing this reader loads from cur after this point is freed before it leaves
+    atomic_store(my_epoch, atomic_load(&sw->epoch));
+    struct hasht *ht = atomic_load(&sw->cur);
+    size_t full_hash = hasht_hash__(ht, key);
+    hasht_value_type value;
+    int rv;
+    while (1) {
+        unsigned long seq_begin = atomic_load_explicit(&sw->seq, memory_order_acquire);
+        if (seq_begin & 1) {
+            hasht_swmr_cpu_relax__(); //the writer is in the middle of a change
+            continue;
+        }
+        ht = atomic_load(&sw->cur);
+        long found_idx;
+        rv = hasht_find_pos_hashed__(ht, key, full_hash, &found_idx);
+        if (rv == HASHT_OK)
+            memcpy(&value, hasht_value_at__(ht, found_idx), sizeof value);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sw->seq, memory_order_relaxed) == seq_begin)
+            break;
+    }
+#ifdef HASHT_STATS
+    hasht_stats_found__(&ht->stats, rv); //before leaving, ht can be freed after that
+#endif
+    atomic_store(my_epoch, 0);
+    if (rv == HASHT_OK && value_out)
+        memcpy(value_out, &value, sizeof value);
+    return rv;
+}
+
+//writer side, all of these must be called from the same thread (or serialized by the caller)
+
+//frees the replaced tables that no reader can see anymore
+static void hasht_swmr_reclaim(struct hasht_swmr *sw) {
+    unsigned long oldest = atomic_load(&sw->epoch);
+    for (int i=0; i<HASHT_SWMR_MAX_READERS; i++) {
+        unsigned long epoch = atomic_load(&sw->readers[i].s.epoch);
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+    struct hasht *ht = hasht_swmr_table__(sw);
+    struct hasht_swmr_retired__ **link = &sw->retired;
+    while (*link) {
+        struct hasht_swmr_retired__ *r = *link;
+        if (r->epoch <= oldest) {
+            *link = r->next;
+            hasht_swmr_free_table__(r->ht);
+            ht->memfuncs.free(r, ht->userdata);
+        }
+        else {
+            link = &r->next;
+        }
+    }
+}
+
+//resizes into a new table, readers keep using the current one (which isn't touched) until the new one is published
+//the arguments are the ones of hasht_init_copy_settings_sz__()
+static int hasht_swmr_resize_to__(struct hasht_swmr *sw, long new_nelements, long new_nbuckets) {
+#ifdef HASHT_STATS
+    long begin_ns = hasht_stats_now_ns__();
+#endif
+    struct hasht *ht = hasht_swmr_table__(sw);
+    struct hasht_swmr_retired__ *retired = ht->memfuncs.alloc(sizeof *retired, ht->userdata);
+    struct hasht *new_ht = ht->memfuncs.alloc(sizeof *new_ht, ht->userdata);
+    int rv = HASHT_ALLOC_ERR;
+    if (!retired || !new_ht)
+        goto fail;
+    rv = hasht_init_copy_settings_sz__(new_ht, new_nelements, new_nbuckets, false, ht);
+    if (rv != HASHT_OK)
+        goto fail;
+    rv = hasht_copy_all_to_new__(new_ht, ht);
+    if (rv != HASHT_OK) {
+        hasht_deinit(new_ht);
+        goto fail;
+    }
+#ifdef HASHT_STR_KEYS
+    hasht_str_arena_move__(new_ht, ht); //readers of the old table still point into it, it's freed with the last table
+#endif
+#ifdef HASHT_STATS
+    //what readers count in the old table from now until they leave it is lost
+    hasht_get_stats(ht, &new_ht->stats);
+    hasht_stats_resized__(&new_ht->stats, new_ht, begin_ns);
+#endif
+    atomic_store(&sw->cur, new_ht);
+    //readers that enter from now on only see new_ht
+    retired->ht = ht;
+    retired->epoch = atomic_fetch_add(&sw->epoch, 1) + 1;
+    retired->next = sw->retired;
+    sw->retired = retired;
+    return HASHT_OK;
+fail:
+    ht->memfuncs.free(retired, ht->userdata);
+    ht->memfuncs.free(new_ht, ht->userdata);
+    return rv;
+}
+
+//same sizes as hasht_if_needed_try_resize()
+static int hasht_swmr_grow__(struct hasht_swmr *sw) {
+    struct hasht *ht = hasht_swmr_table__(sw);
+#ifdef HASHT_POW2
+    return hasht_swmr_resize_to__(sw, 0, ht->nbuckets * 2);
+#else
+    long new_bucket_count = hasht_calc_nelements_to_nbuckets(ht->nelements, ht->shrink_at_percentage, ht->grow_at_percentage);
+    if (ht->nbuckets_po2 == hasht_get_power_idx(new_bucket_count))
+        return HASHT_RESIZE_REFUSE; //hasht_resize__ wouldn't resize either
+    return hasht_swmr_resize_to__(sw, new_bucket_count, -1);
+#endif
+}
+
+static void hasht_swmr_write_begin__(struct hasht_swmr *sw) {
+    atomic_store_explicit(&sw->seq, atomic_load_explicit(&sw->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+static void hasht_swmr_write_end__(struct hasht_swmr *sw) {
+    atomic_store_explicit(&sw->seq, atomic_load_explicit(&sw->seq, memory_order_relaxed) + 1, memory_order_release);
+}
+
+static int hasht_swmr_insert__(struct hasht_swmr *sw, hasht_key_type *key, hasht_value_type *value, bool or_replace) {
+    struct hasht *ht = hasht_swmr_table__(sw);
+    size_t full_hash = hasht_hash__(ht, key);
+    if (ht->nelements >= ht->grow_at_gt_n || hasht_at_insert_must_resize(ht)) {
+        //grow before the insert, so that hasht_insert_hashed__ never resizes in place
+        int rv = hasht_swmr_grow__(sw);
+        if (rv != HASHT_OK && rv != HASHT_RESIZE_REFUSE && hasht_at_insert_must_resize(ht))
+            return rv == HASHT_ALLOC_ERR ? rv : HASHT_FAILED_AT_RESIZE;
+        ht = hasht_swmr_table__(sw);
+    }
+    long idx_unused;
+    hasht_swmr_write_begin__(sw);
+    int rv = hasht_insert_hashed__(ht, key, full_hash, value, &idx_unused, or_replace);
+    hasht_swmr_write_end__(sw);
+    if (sw->retired)
+        hasht_swmr_reclaim(sw);
+    return rv;
+}
+static int hasht_swmr_insert(struct hasht_swmr *sw, hasht_key_type *key, hasht_value_type *value) {
+    return hasht_swmr_insert__(sw, key, value, false /*dont replace*/);
+}
+static int hasht_swmr_insert_or_replace(struct hasht_swmr *sw, hasht_key_type *key, hasht_value_type *value) {
+    return hasht_swmr_insert__(sw, key, value, true /*do replace*/);
+}
+
+static int hasht_swmr_remove(struct hasht_swmr *sw, hasht_key_type *key) {
+    struct hasht *ht = hasht_swmr_table__(sw);
+    size_t full_hash = hasht_hash__(ht, key);
+    long found_idx;
+    //finding doesn't change anything, only the removal needs to be wrapped
+    int rv = hasht_find_pos_hashed__(ht, key, full_hash, &found_idx);
+    if (rv != HASHT_OK)
+        return rv;
+    hasht_swmr_write_begin__(sw);
+    hasht_remove_at__(ht, found_idx, full_hash);
+    hasht_swmr_write_end__(sw);
+    long new_nbuckets = hasht_shrink_target__(ht);
+    if (new_nbuckets > 0)
+        hasht_swmr_resize_to__(sw, 0, new_nbuckets); //the pair is removed even if shrinking fails
+    if (sw->retired)
+        hasht_swmr_reclaim(sw);
+    return HASHT_OK;
+}
+
+#ifdef HASHT_STATS
+//the counters of the current table, the finds of the readers included
+static void hasht_swmr_get_stats(struct hasht_swmr *sw, struct hasht_stats *out) {
+    hasht_get_stats(hasht_swmr_table__(sw), out);
+}
+#endif
+#endif // HASHT_SWMR
+
+#ifdef HASHT_SNAPSHOT
+//the file is the header (padded to HASHT_SNAPSHOT_DATA_OFF, so the pairs are page aligned when mapped),
+//the allocation of tab as it is in memory (the pairs, then the control bytes),
+//and with HASHT_SOA the values, at the next HASHT_CACHE_LINE boundary
+#define HASHT_SNAPSHOT_MAGIC    0x31746e73746873ULL //"shtsnt1", reads differently with the other byte order
+#define HASHT_SNAPSHOT_DATA_OFF 4096L
+
+struct hasht_snapshot_hdr__ {
+    uint64_t magic;
+    uint64_t modes; //see hasht_snapshot_modes__()
+    uint64_t pair_sz;
+    uint64_t key_sz;
+    uint64_t value_sz;
+    int64_t nbuckets;
+    int64_t nbuckets_po2;
+    int64_t nelements;
+    int64_t ndeleted;
+    int64_t shrink_at_percentage;
+    int64_t grow_at_percentage;
+    uint64_t tab_sz;
+    uint64_t values_sz; //0 without HASHT_SOA
+    uint64_t data_checksum; //of tab, then of values
+    uint64_t hdr_checksum; //of the fields above, must stay last
+};
+
+//the modes that change where a key is or how its bucket is laid out, a snapshot can only be mapped with the same ones
+static uint64_t hasht_snapshot_modes__(void) {
+    uint64_t modes = 0;
+#ifdef HASHT_CTRL_BYTES
+    modes |= 1U << 0;
+    modes |= (uint64_t) HASHT_GROUP_WIDTH << 32; //the number of mirrored control bytes
+#endif
+#ifdef HASHT_POW2
+    modes |= 1U << 1;
+#endif
+#ifdef HASHT_64BIT
+    modes |= 1U << 2;
+#endif
+#ifdef HASHT_ROBIN_HOOD
+    modes |= 1U << 3;
+#endif
+#ifdef HASHT_STORE_HASH
+    modes |= 1U << 4;
+#endif
+#ifdef HASHT_SOA
+    modes |= 1U << 5;
+#endif
+    return modes;
+}
+
+//not cryptographic, it only catches truncated and damaged files
+static uint64_t hasht_snapshot_checksum__(uint64_t h, const void *data, size_t sz) {
+    const unsigned char *p = (const unsigned char *) data;
+    for (; sz >= sizeof(uint64_t); sz -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof word);
+        h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    for (; sz > 0; sz--, p++)
+        h = (h ^ *p) * 0x100000001B3ULL;
+    return h;
+}
+
+static size_t hasht_snapshot_values_off__(size_t tab_sz) {
+    return HASHT_SNAPSHOT_DATA_OFF + (tab_sz + HASHT_CACHE_LINE - 1) / HASHT_CACHE_LINE * HASHT_CACHE_LINE;
+}
+
+static int hasht_write_all__(int fd, const void *data, size_t sz) {
+    const char *p = (const char *) data;
+    while (sz > 0) {
+        ssize_t n = write(fd, p, sz);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return HASHT_IO_ERR;
+        }
+        p += n;
+        sz -= (size_t) n;
+    }
+    return HASHT_OK;
+}
+
+//skips sz bytes of fd, which must be at the end of the file, so they read as zeros (and take no disk space)
+static int hasht_write_zeros__(int fd, size_t sz) {
+    if (sz > 0 && lseek(fd, (off_t) sz, SEEK_CUR) < 0)
+        return HASHT_IO_ERR;
+    return HASHT_OK;
+}
+
+//writes ht to fd, from its current position (which should be the start of an empty file), to be mapped back with hasht_open_mapped()
+//fd must be seekable, the padding between the parts is skipped over
+//with HASHT_INCREMENTAL_RESIZE a resize in progress is finished first, otherwise ht isn't changed
+static int hasht_save(struct hasht *ht, int fd) {
+    int rv;
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(ht);
+    if (rv != HASHT_OK)
+        return rv;
+#endif
+    struct hasht_snapshot_hdr__ hdr;
+    memset(&hdr, 0, sizeof hdr);
+    hdr.magic = HASHT_SNAPSHOT_MAGIC;
+    hdr.modes = hasht_snapshot_modes__();
+    hdr.pair_sz = sizeof(struct hasht_pair_type);
+    hdr.key_sz = sizeof(hasht_key_type);
+    hdr.value_sz = sizeof(hasht_value_type);
+    hdr.nbuckets = ht->nbuckets;
+    hdr.nbuckets_po2 = ht->nbuckets_po2;
+    hdr.nelements = ht->nelements;
+    hdr.ndeleted = ht->ndeleted;
+    hdr.shrink_at_percentage = ht->shrink_at_percentage;
+    hdr.grow_at_percentage = ht->grow_at_percentage;
+    hdr.tab_sz = hasht_tab_alloc_sz(ht->nbuckets);
+    hdr.data_checksum = hasht_snapshot_checksum__(0, ht->tab, hdr.tab_sz);
+#ifdef HASHT_SOA
+    hdr.values_sz = sizeof(hasht_value_type) * ht->nbuckets;
+    hdr.data_checksum = hasht_snapshot_checksum__(hdr.data_checksum, ht->values, hdr.values_sz);
+#endif
+    hdr.hdr_checksum = hasht_snapshot_checksum__(0, &hdr, offsetof(struct hasht_snapshot_hdr__, hdr_checksum));
+
+    rv = hasht_write_all__(fd, &hdr, sizeof hdr);
+    if (rv == HASHT_OK)
+        rv = hasht_write_zeros__(fd, HASHT_SNAPSHOT_DATA_OFF - sizeof hdr);
+    if (rv == HASHT_OK)
+        rv = hasht_write_all__(fd, ht->tab, hdr.tab_sz);
+#ifdef HASHT_SOA
+    if (rv == HASHT_OK)
+        rv = hasht_write_zeros__(fd, hasht_snapshot_values_off__(hdr.tab_sz) - HASHT_SNAPSHOT_DATA_OFF - hdr.tab_sz);
+    if (rv == HASHT_OK)
+        rv = hasht_write_all__(fd, ht->values, hdr.values_sz);
+#endif
+    return rv;
+}
+
+static bool hasht_snapshot_hdr_ok__(const struct hasht_snapshot_hdr__ *hdr, size_t file_sz) {
+    if (hdr->magic != HASHT_SNAPSHOT_MAGIC)
+        return false;
+    if (hdr->hdr_checksum != hasht_snapshot_checksum__(0, hdr, offsetof(struct hasht_snapshot_hdr__, hdr_checksum)))
+        return false;
+    if (hdr->modes != hasht_snapshot_modes__() || hdr->pair_sz != sizeof(struct hasht_pair_type)
+        || hdr->key_sz != sizeof(hasht_key_type) || hdr->value_sz != sizeof(hasht_value_type))
+        return false;
+    if (hdr->nbuckets < HASHT_MIN_TABLESIZE || hdr->nelements < 0 || hdr->ndeleted < 0
+        || hdr->nelements + hdr->ndeleted > hdr->nbuckets)
+        return false;
+    if (hdr->tab_sz != hasht_tab_alloc_sz(hdr->nbuckets))
+        return false;
+#ifdef HASHT_SOA
+    if (hdr->values_sz != sizeof(hasht_value_type) * hdr->nbuckets)
+        return false;
+    return file_sz >= hasht_snapshot_values_off__(hdr->tab_sz) + hdr->values_sz;
+#else
+    return file_sz >= HASHT_SNAPSHOT_DATA_OFF + hdr->tab_sz;
+#endif
+}
+
+//maps a file written by hasht_save() into ht, which is then used in place (instead of reinserting every pair):
+//opening only reads the header, and each lookup faults in the pages it touches
+//the mapping is private, the first insert or remove that writes to a page gets its own copy of that page
+//(the file is never changed), and the next resize moves everything to memory from the default allocator
+//the allocator and userdata are the defaults of hasht_init(), userdata can be set afterwards
+//it fills in ht like hasht_init() does, instead of returning a new table
+//the header is always checked, verify_data also checks the buckets against the checksum:
+//that reads the whole file, which is the work that mapping it is meant to avoid, so it's up to the caller
+static int hasht_open_mapped(struct hasht *ht, const char *path, bool verify_data) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return HASHT_IO_ERR;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return HASHT_IO_ERR;
+    }
+    if (st.st_size < HASHT_SNAPSHOT_DATA_OFF) {
+        close(fd);
+        return HASHT_BAD_SNAPSHOT;
+    }
+    size_t file_sz = (size_t) st.st_size;
+    void *mapping = mmap(NULL, file_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); //the mapping keeps the file open
+    if (mapping == MAP_FAILED)
+        return HASHT_IO_ERR;
+
+    struct hasht_snapshot_hdr__ hdr;
+    memcpy(&hdr, mapping, sizeof hdr);
+    int rv = HASHT_BAD_SNAPSHOT;
+    if (!hasht_snapshot_hdr_ok__(&hdr, file_sz))
+        goto fail;
+    char *tab = (char *) mapping + HASHT_SNAPSHOT_DATA_OFF;
+#ifdef HASHT_SOA
+    char *values = (char *) mapping + hasht_snapshot_values_off__(hdr.tab_sz);
+#endif
+    if (verify_data) {
+        uint64_t checksum = hasht_snapshot_checksum__(0, tab, hdr.tab_sz);
+#ifdef HASHT_SOA
+        checksum = hasht_snapshot_checksum__(checksum, values, hdr.values_sz);
+#endif
+        if (checksum != hdr.data_checksum)
+            goto fail;
+    }
+    rv = hasht_init_fields__(ht, 0, hdr.nbuckets, hasht_def_malloc, hasht_def_realloc, hasht_def_free, hasht_def_zalloc, NULL,
+                             hdr.shrink_at_percentage, hdr.grow_at_percentage);
+    if (rv != HASHT_OK)
+        goto fail;
+    if (ht->nbuckets != hdr.nbuckets || ht->nbuckets_po2 != hdr.nbuckets_po2) {
+        rv = HASHT_BAD_SNAPSHOT; //not one of the sizes of this build
+        goto fail;
+    }
+    ht->tab = (struct hasht_pair_type *) tab;
+#ifdef HASHT_SOA
+    ht->values = (hasht_value_type *) values;
+#endif
+#ifdef HASHT_CTRL_BYTES
+    ht->ctrl = (unsigned char *) (ht->tab + ht->nbuckets);
+#endif
+    ht->nelements = hdr.nelements;
+    ht->ndeleted = hdr.ndeleted;
+    ht->mapping = mapping;
+    ht->mapping_sz = file_sz;
+    HASHT_ASSERT(hasht_dbg_sanity_01(ht), "");
+    return HASHT_OK;
+fail:
+    munmap(mapping, file_sz);
+    return rv;
+}
+#endif // HASHT_SNAPSHOT
@@ -0,0 +1,227 @@
+//must define this in build system, otherwise the tests are useless #define HASHT_DBG
+//string keys, built with HASHT_STR_KEYS (and HASHT_STR_VALUES, HASHT_INLINE_KEYS)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+typedef const char * hasht_key_type;
+typedef const char * hasht_value_type;
+
+long hash_calls = 0;
+
+size_t hasht_hash(hasht_key_type *key) {
+    hash_calls++;
+    size_t h = 14695981039346656037UL; //fnv-1a
+    for (const char *c = *key; *c; c++)
+        h = (h ^ (unsigned char) *c) * 1099511628211UL;
+    return h;
+}
+
+int hasht_key_eq_cmp(hasht_key_type *key_1, hasht_key_type *key_2) {
+    return strcmp(*key_1, *key_2);
+}
+#include "../src/hasht.h"
+
+//the keys and values are written to the same buffers every time, only the table's copies survive
+static char key_buff[64];
+static char value_buff[64];
+static const char *mk_key(int i) {
+    snprintf(key_buff, sizeof key_buff, "key number %d", i);
+    return key_buff;
+}
+static const char *mk_value(int i, int version) {
+    snprintf(value_buff, sizeof value_buff, "value %d, version %d", i, version);
+    return value_buff;
+}
+
+void test_copies_strings(void) {
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+    const int n = 5000;
+    for (int i=0; i<n; i++) {
+        const char *key = mk_key(i);
+        const char *value = mk_value(i, 0);
+        rv = hasht_insert(&ht, &key, &value);
+        assert(rv == HASHT_OK);
+    }
+    //resizing used the hashes stored with the keys
+    assert(hash_calls == n);
+    assert(ht.nelements == n);
+
+    for (int i=0; i<n; i++) {
+        const char *key = mk_key(i);
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK);
+        assert(iter.pair->key != key_buff && strcmp(iter.pair->key, key) == 0);
+        assert(hasht_str_len(iter.pair->key) == strlen(key));
+#ifdef HASHT_STR_VALUES
+        assert(iter.pair->value != value_buff && strcmp(iter.pair->value, mk_value(i, 0)) == 0);
+        assert(hasht_str_len(iter.pair->value) == strlen(value_buff));
+#endif
+    }
+
+    //replacing keeps the stored key, and stores the new value
+    for (int i=0; i<n; i += 3) {
+        const char *key = mk_key(i);
+        const char *value = mk_value(i, 1);
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK);
+        const char *stored_key = iter.pair->key;
+        rv = hasht_find_or_insert(&ht, &key, &value, &iter);
+        assert(rv == HASHT_OK);
+        assert(iter.pair->key == stored_key);
+#ifdef HASHT_STR_VALUES
+        assert(iter.pair->value != value_buff && strcmp(iter.pair->value, mk_value(i, 1)) == 0);
+#endif
+    }
+
+    //new keys with NULL values
+    for (int i=n; i<n + 100; i++) {
+        const char *key = mk_key(i);
+        struct hasht_iter iter;
+        bool inserted;
+        rv = hasht_try_emplace(&ht, &key, NULL, &iter, &inserted);
+        assert(rv == HASHT_OK && inserted && !iter.pair->value);
+        assert(iter.pair->key != key_buff && strcmp(iter.pair->key, key) == 0);
+    }
+
+    for (int i=0; i<n + 100; i += 2) {
+        const char *key = mk_key(i);
+        rv = hasht_remove(&ht, &key);
+        assert(rv == HASHT_OK);
+    }
+    assert(ht.nelements == (n + 100) / 2);
+
+    //every pair left, by iterating
+    long nseen = 0;
+    struct hasht_iter iter;
+    for (rv = hasht_begin_iterator(&ht, &iter); rv == HASHT_OK; rv = hasht_iter_next(&ht, &iter)) {
+        int i;
+        assert(sscanf(iter.pair->key, "key number %d", &i) == 1);
+        assert(i % 2 == 1 && i < n + 100);
+#ifdef HASHT_STR_VALUES
+        if (i < n)
+            assert(strcmp(iter.pair->value, mk_value(i, i % 3 == 0 ? 1 : 0)) == 0);
+#endif
+        nseen++;
+    }
+    assert(nseen == ht.nelements);
+    hasht_deinit(&ht); //everything the table copied is freed here, asan checks for leaks
+}
+
+void test_long_strings(void) {
+    //strings that don't fit in a chunk, mixed with short ones
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+    const int n = 40;
+    size_t long_sz = HASHT_STR_CHUNK + 100;
+    char *buff = malloc(long_sz + 32);
+    assert(buff);
+    for (int i=0; i<n; i++) {
+        size_t len = i % 2 ? long_sz : 10;
+        memset(buff, 'a' + i % 26, len);
+        snprintf(buff + len, 32, "%d", i);
+        const char *key = buff;
+        const char *value = buff;
+        rv = hasht_insert(&ht, &key, &value);
+        assert(rv == HASHT_OK);
+    }
+    for (int i=0; i<n; i++) {
+        size_t len = i % 2 ? long_sz : 10;
+        memset(buff, 'a' + i % 26, len);
+        snprintf(buff + len, 32, "%d", i);
+        const char *key = buff;
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK);
+        assert(iter.pair->key != buff && hasht_str_len(iter.pair->key) == strlen(buff));
+    }
+    free(buff);
+    hasht_deinit(&ht);
+}
+
+void test_shared_prefix(void) {
+    //runs of 'p' with and without a one character tail, so long keys share their prefix (and inline part) with others
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+    const char tails[] = "\0" "0123456789";
+    char buff[64];
+    const char *key = buff;
+    const char *value = NULL;
+    for (int pass=0; pass<2; pass++) {
+        for (int len=1; len<=40; len++) {
+            for (int t=0; t<(int) sizeof tails; t++) {
+                memset(buff, 'p', len);
+                buff[len] = tails[t];
+                buff[len + 1] = '\0';
+                if (pass == 0) {
+                    rv = hasht_insert(&ht, &key, &value);
+                    //the last entry of tails is the terminator of the literal, the same key as the first
+                    assert(rv == (t == (int) sizeof tails - 1 ? HASHT_DUPLICATE_KEY : HASHT_OK));
+                    continue;
+                }
+                struct hasht_iter iter;
+                rv = hasht_find(&ht, &key, &iter);
+                assert(rv == HASHT_OK && strcmp(iter.pair->key, buff) == 0);
+                buff[len + 1] = 'x';
+                buff[len + 2] = '\0';
+                rv = hasht_find(&ht, &key, &iter);
+                assert(rv == (tails[t] == '\0' ? HASHT_OK : HASHT_NOT_FOUND)); //"ppp\0x" is still "ppp"
+            }
+        }
+    }
+    assert(ht.nelements == 40 * 11);
+    hasht_deinit(&ht);
+}
+
+void test_build_from_arrays(void) {
+    const int n = 3000;
+    const char **keys = malloc(sizeof(*keys) * (n + 1));
+    const char **values = malloc(sizeof(*values) * (n + 1));
+    char (*strs)[32] = malloc(sizeof(*strs) * (n + 1));
+    assert(keys && values && strs);
+    for (int i=0; i<n; i++) {
+        snprintf(strs[i], sizeof strs[i], "built %d", i);
+        keys[i] = strs[i];
+        values[i] = strs[i];
+    }
+    keys[n] = keys[0]; //duplicate
+    values[n] = "duplicate";
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK);
+    rv = hasht_build_from_arrays(&ht, keys, values, n + 1, 4);
+    assert(rv == HASHT_DUPLICATE_KEY);
+    assert(ht.nelements == n);
+    free(strs); //the table has its own copies
+    for (int i=0; i<n; i++) {
+        char key_buff[32];
+        snprintf(key_buff, sizeof key_buff, "built %d", i);
+        const char *key = key_buff;
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK && strcmp(iter.pair->key, key_buff) == 0);
+#ifdef HASHT_STR_VALUES
+        assert(strcmp(iter.pair->value, key_buff) == 0); //the first one wins
+#endif
+    }
+    free(keys);
+    free(values);
+    hasht_deinit(&ht);
+}
+
+int main(void) {
+    test_copies_strings();
+    test_long_strings();
+    test_shared_prefix();
+    test_build_from_arrays();
+    printf("success\n");
+    return 0;
+}
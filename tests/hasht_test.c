@@ -4,9 +4,12 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <limits.h>
 typedef int hasht_key_type; 
 typedef int hasht_value_type; 
 
+_Thread_local long hash_calls = 0; //how many times the table hashed a key (on this thread, the bulk build hashes from several)
+
 #ifdef HASHT_DATA_ARG
 int mydata[] = {213123,2313123,664536,3423424,31231231};
 void assert_udata_is_ok(void *udata) {
@@ -17,6 +20,7 @@ void assert_udata_is_ok(void *udata) {
 }
 size_t hasht_hash(void *udata, hasht_key_type *key) {
     assert_udata_is_ok(udata);
+    hash_calls++;
     return *key;
 }
 
@@ -26,6 +30,7 @@ bool hasht_key_eq_cmp(void *udata, hasht_key_type *key_1, hasht_key_type *key_2)
 }
 #else
 size_t hasht_hash(hasht_key_type *key) {
+    hash_calls++;
     return *key;
 }
 
@@ -33,6 +38,36 @@ bool hasht_key_eq_cmp(hasht_key_type *key_1, hasht_key_type *key_2) {
     return *key_1 == *key_2 ? 0 : 1;
 }
 #endif
+#ifdef HASHT_PROBE
+//keys looked up by their decimal digits, an unterminated slice of a string
+typedef struct {
+    const char *digits;
+    int len;
+} hasht_probe_type;
+int probe_to_int(hasht_probe_type *probe) {
+    int value = 0;
+    for (int i=0; i<probe->len; i++)
+        value = value * 10 + (probe->digits[i] - '0');
+    return value;
+}
+#ifdef HASHT_DATA_ARG
+size_t hasht_probe_hash(void *udata, hasht_probe_type *probe) {
+    assert_udata_is_ok(udata);
+    return probe_to_int(probe); //same as hasht_hash() of the key
+}
+int hasht_probe_eq_cmp(void *udata, hasht_probe_type *probe, hasht_key_type *key) {
+    assert_udata_is_ok(udata);
+    return probe_to_int(probe) == *key ? 0 : 1;
+}
+#else
+size_t hasht_probe_hash(hasht_probe_type *probe) {
+    return probe_to_int(probe); //same as hasht_hash() of the key
+}
+int hasht_probe_eq_cmp(hasht_probe_type *probe, hasht_key_type *key) {
+    return probe_to_int(probe) == *key ? 0 : 1;
+}
+#endif
+#endif // HASHT_PROBE
 #include "../src/hasht.h"
 
 /*
@@ -155,6 +190,8 @@ int values2[][2] = {
 { 3606, 5321 },
 { 9585, 353 },
 };
+static const int arr1_sz = sizeof values / sizeof values[0];
+static const int arr2_sz = sizeof values2 / sizeof values2[0];
 
 void *xmalloc(size_t sz) {
     void *m = malloc(sz);
@@ -193,7 +230,10 @@ void test_find_all_arr2(struct hasht *ht, int arr[][2], int nelems) {
         assert(rv == HASHT_OK);
         assert(iter.pair);
         assert(iter.pair->key == arr[i][0]);
-        assert(iter.pair->value == arr[i][1]);
+        assert(*iter.value == arr[i][1]);
+#ifndef HASHT_SOA
+        assert(iter.value == &iter.pair->value);
+#endif
     }
 }
 
@@ -252,17 +292,18 @@ void test_find_all_arr2_expect_not_found(struct hasht *ht, int arr[][2], int nel
         assert(rv == HASHT_NOT_FOUND);
     }
 }
-void test_init_add_arrays_find(void) {
-    struct hasht ht;
-    int rv = hasht_init(&ht, 0);
+//a table for a test, with the userdata that hasht_hash() and hasht_key_eq_cmp() check for
+void test_init_table(struct hasht *ht, long initial_nelements) {
+    int rv = hasht_init(ht, initial_nelements);
     assert(rv == HASHT_OK);
-
 #ifdef HASHT_DATA_ARG
-    ht.userdata = mydata;
+    ht->userdata = mydata;
 #endif
+}
 
-    int arr1_sz = sizeof values / sizeof values[0];
-    int arr2_sz = sizeof values2 / sizeof values2[0];
+void test_init_add_arrays_find(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
     test_insert_all_arr2(&ht, values, arr1_sz);
     test_find_all_arr2(&ht, values, arr1_sz);
     test_delete_all_arr2(&ht, values, arr1_sz);
@@ -288,7 +329,1048 @@ void test_init_add_arrays_find(void) {
     hasht_deinit(&ht);
 }
 
+#ifdef HASHT_ROBIN_HOOD
+//deletes shift entries back instead of leaving deleted buckets behind
+void test_robin_hood_churn(void) {
+    struct hasht ht;
+    test_init_table(&ht, 64);
+    for (int round=0; round<20; round++) {
+        test_insert_all_arr2(&ht, values, arr1_sz);
+        test_insert_all_arr2(&ht, values2, arr2_sz);
+        test_delete_all_arr2(&ht, values, arr1_sz);
+        assert(ht.ndeleted == 0);
+        assert(hasht_dbg_check_robin_hood(&ht));
+        test_find_all_arr2(&ht, values2, arr2_sz);
+        test_find_all_arr2_expect_not_found(&ht, values, arr1_sz);
+        test_delete_all_arr2(&ht, values2, arr2_sz);
+        assert(hasht_n_empty_buckets(&ht) == ht.nbuckets);
+    }
+    hasht_deinit(&ht);
+}
+#endif
+
+#ifdef HASHT_INCREMENTAL_RESIZE
+//everything must stay reachable while the buckets are being moved to the new table
+void test_incremental_resize(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    bool seen_in_progress = false;
+    for (int i=0; i<arr1_sz; i++) {
+        rv = hasht_insert(&ht, &values[i][0], &values[i][1]);
+        assert(rv == HASHT_OK);
+        if (ht.old) {
+            seen_in_progress = true;
+            test_find_all_arr2(&ht, values, i + 1);
+            rv = hasht_insert(&ht, &values[0][0], &values[0][1]);
+            assert(rv == HASHT_DUPLICATE_KEY);
+        }
+        assert(ht.nelements == i + 1);
+    }
+    assert(seen_in_progress);
+    test_insert_all_arr2(&ht, values2, arr2_sz);
+    test_delete_all_arr2(&ht, values, arr1_sz);
+    test_find_all_arr2(&ht, values2, arr2_sz);
+    rv = hasht_finish_resize(&ht);
+    assert(rv == HASHT_OK);
+    assert(ht.old == NULL);
+    test_iter_expect_seen(&ht, values2, arr2_sz, arr2_sz);
+    hasht_deinit(&ht);
+}
+#endif
+
+#ifdef HASHT_STORE_HASH
+//growing and shrinking reuse the stored hashes, so every operation hashes exactly once
+void test_store_hash_no_rehash(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    long nbuckets_before = ht.nbuckets;
+    hash_calls = 0;
+    test_insert_all_arr2(&ht, values, arr1_sz);
+    test_insert_all_arr2(&ht, values2, arr2_sz);
+    assert(ht.nbuckets != nbuckets_before); //it must have resized
+    test_find_all_arr2(&ht, values, arr1_sz);
+    test_delete_all_arr2(&ht, values, arr1_sz);
+    assert(hash_calls == 3 * arr1_sz + arr2_sz);
+    test_find_all_arr2(&ht, values2, arr2_sz);
+    hasht_deinit(&ht);
+}
+#endif
+
+//steady insert/delete churn must not fill the table up with deleted buckets
+void test_churn_purges_deleted(void) {
+    struct hasht ht;
+    test_init_table(&ht, 100);
+    int rv;
+    const int window = 100;
+    for (int key=0; key<50000; key++) {
+        rv = hasht_insert(&ht, &key, &key);
+        assert(rv == HASHT_OK);
+        if (key >= window) {
+            int old_key = key - window;
+            rv = hasht_remove(&ht, &old_key);
+            assert(rv == HASHT_OK);
+        }
+        assert(ht.ndeleted <= ht.purge_at_deleted_n);
+        assert(hasht_n_empty_buckets(&ht) > 0);
+    }
+    //explicitly
+    for (int key=50000-window; key<50000; key += 2) {
+        rv = hasht_remove(&ht, &key);
+        assert(rv == HASHT_OK);
+    }
+    rv = hasht_purge_deleted(&ht);
+    assert(rv == HASHT_OK);
+    assert(ht.ndeleted == 0);
+    for (int key=50000-window; key<50000; key++) {
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == (key % 2 ? HASHT_OK : HASHT_NOT_FOUND));
+    }
+    test_iter_expect_count(&ht, window / 2);
+    hasht_deinit(&ht);
+}
+
+void test_find_batch(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    test_insert_all_arr2(&ht, values, arr1_sz);
+
+    //missing keys (from values2) mixed in, and the count isn't a multiple of the batch width
+    long nkeys = arr1_sz + arr2_sz;
+    hasht_key_type *keys = xmalloc(sizeof(hasht_key_type) * nkeys);
+    struct hasht_iter *iters = xmalloc(sizeof(struct hasht_iter) * nkeys);
+    int *results = xmalloc(sizeof(int) * nkeys);
+    int next1 = 0, next2 = 0;
+    for (long i=0; i<nkeys; i++)
+        keys[i] = (i % 3 == 1 && next2 < arr2_sz) || next1 == arr1_sz ? values2[next2++][0] : values[next1++][0];
+    rv = hasht_find_batch(&ht, keys, nkeys, iters);
+    assert(rv == HASHT_OK);
+    rv = hasht_contains_batch(&ht, keys, nkeys, results);
+    assert(rv == HASHT_OK);
+    for (long i=0; i<nkeys; i++) {
+        long idx = linear_find(values, arr1_sz, keys[i]);
+        if (idx >= 0) {
+            assert(iters[i].pair);
+            assert(iters[i].pair->key == keys[i]);
+            assert(*iters[i].value == values[idx][1]);
+            assert(results[i] == HASHT_OK);
+        }
+        else {
+            assert(!iters[i].pair);
+            assert(results[i] == HASHT_NOT_FOUND);
+        }
+    }
+    free(keys);
+    free(iters);
+    free(results);
+    hasht_deinit(&ht);
+}
+
+void test_build_from_arrays(void) {
+    const long n = 20000;
+    hasht_key_type *keys = xmalloc(sizeof(hasht_key_type) * n);
+    hasht_value_type *vals = xmalloc(sizeof(hasht_value_type) * n);
+    //runs of consecutive keys make long probe sequences, some of which cross from one thread's range to the next
+    //the rest are scattered (and distinct, multiplying by an odd number is a bijection mod 2^30)
+    for (long i=0; i<n; i++) {
+        keys[i] = (i % 1000 < 600) ? (int) i : (int) (((unsigned) i * 2654435761U) & 0x3FFFFFFF) + (int) n;
+        vals[i] = (int) i;
+    }
+    keys[n - 1] = keys[5]; //a duplicate, the first one must win
+    for (long nthreads=1; nthreads<=8; nthreads *= 2) {
+        struct hasht ht;
+        test_init_table(&ht, 0);
+        int rv;
+        rv = hasht_build_from_arrays(&ht, keys, vals, n, nthreads);
+        assert(rv == HASHT_DUPLICATE_KEY);
+        for (long i=0; i<n; i++) {
+            struct hasht_iter iter;
+            rv = hasht_find(&ht, keys + i, &iter);
+            assert(rv == HASHT_OK);
+            assert(*iter.value == vals[i == n - 1 ? 5 : i]);
+        }
+        assert(ht.nelements == n - 1);
+        test_iter_expect_count(&ht, n - 1);
+        //still a normal table afterwards
+        int key = -1;
+        rv = hasht_insert(&ht, &key, &key);
+        assert(rv == HASHT_OK);
+        hasht_deinit(&ht);
+    }
+    free(keys);
+    free(vals);
+}
+
+#ifdef HASHT_PROBE
+void test_find_as(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    for (int i=0; i<2000; i++) {
+        int value = -i;
+        rv = hasht_insert(&ht, &i, &value);
+        assert(rv == HASHT_OK);
+    }
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(&ht); //moving what's left of the old table hashes its keys
+    assert(rv == HASHT_OK);
+#endif
+    //"1234" followed by other digits, never terminated where the key ends
+    const char *buff = "123456789";
+    for (int len=1; len<=4; len++) {
+        hasht_probe_type probe = { buff, len };
+        int key = probe_to_int(&probe);
+        struct hasht_iter iter;
+        long calls = hash_calls;
+        rv = hasht_find_as(&ht, &probe, &iter);
+        assert(rv == HASHT_OK);
+        assert(iter.pair->key == key && *iter.value == -key);
+        assert(hash_calls == calls); //the key type was never hashed
+        rv = hasht_remove_as(&ht, &probe);
+        assert(rv == HASHT_OK);
+        rv = hasht_find_as(&ht, &probe, &iter);
+        assert(rv == HASHT_NOT_FOUND && !iter.pair);
+        rv = hasht_remove_as(&ht, &probe);
+        assert(rv == HASHT_NOT_FOUND);
+    }
+    hasht_probe_type missing = { "99999", 5 };
+    struct hasht_iter iter;
+    rv = hasht_find_as(&ht, &missing, &iter);
+    assert(rv == HASHT_NOT_FOUND);
+    assert(ht.nelements == 2000 - 4);
+    hasht_deinit(&ht);
+}
+#endif // HASHT_PROBE
+
+void test_hashed_api(void) {
+    //two tables with the same hasht_hash(), every key is hashed once for both
+    struct hasht ht1, ht2;
+    test_init_table(&ht1, 0);
+    test_init_table(&ht2, 100);
+    int rv;
+    const int n = 3000;
+    for (int i=0; i<n; i++) {
+        hash_calls = 0;
+#ifndef HASHT_STORE_HASH
+        long nbuckets1 = ht1.nbuckets, nbuckets2 = ht2.nbuckets;
+    #ifdef HASHT_INCREMENTAL_RESIZE
+        bool was_resizing = ht1.old || ht2.old;
+    #endif
+#endif
+        size_t hash = hasht_hash_key(&ht1, &i);
+        int value = i * 2;
+        rv = hasht_insert_hashed(&ht1, &i, hash, &i);
+        assert(rv == HASHT_OK);
+        rv = hasht_insert_hashed(&ht1, &i, hash, &i);
+        assert(rv == HASHT_DUPLICATE_KEY);
+        struct hasht_iter iter;
+        rv = hasht_find_or_insert_hashed(&ht2, &i, hash, &value, &iter);
+        assert(rv == HASHT_OK && *iter.value == value);
+        rv = hasht_find_hashed(&ht1, &i, hash, &iter);
+        assert(rv == HASHT_OK && *iter.value == i);
+#ifndef HASHT_STORE_HASH
+        //resizing hashes the keys that are moved
+        bool resized = nbuckets1 != ht1.nbuckets || nbuckets2 != ht2.nbuckets;
+    #ifdef HASHT_INCREMENTAL_RESIZE
+        resized = resized || was_resizing || ht1.old || ht2.old;
+    #endif
+        assert(hash_calls == 1 || resized);
+#else
+        assert(hash_calls == 1);
+#endif
+    }
+    for (int i=0; i<n; i += 2) {
+        size_t hash = hasht_hash_key(&ht2, &i);
+        rv = hasht_remove_hashed(&ht1, &i, hash);
+        assert(rv == HASHT_OK);
+        rv = hasht_remove_hashed(&ht2, &i, hash);
+        assert(rv == HASHT_OK);
+        rv = hasht_remove_hashed(&ht2, &i, hash);
+        assert(rv == HASHT_NOT_FOUND);
+        struct hasht_iter iter;
+        rv = hasht_find_hashed(&ht1, &i, hash, &iter);
+        assert(rv == HASHT_NOT_FOUND && !iter.pair);
+    }
+    assert(ht1.nelements == n / 2 && ht2.nelements == n / 2);
+    hasht_deinit(&ht1);
+    hasht_deinit(&ht2);
+}
+
+void test_remove_iter(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    const int n = 5000;
+    for (int i=0; i<n; i++) {
+        rv = hasht_insert(&ht, &i, &i);
+        assert(rv == HASHT_OK);
+    }
+    //through an iterator from a find
+    for (int i=0; i<n; i += 5) {
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &i, &iter);
+        assert(rv == HASHT_OK);
+        rv = hasht_remove_iter(&ht, &iter);
+        assert(rv == HASHT_OK);
+        rv = hasht_remove_iter(&ht, &iter);
+        assert(rv == HASHT_NOT_FOUND);
+        rv = hasht_find(&ht, &i, &iter);
+        assert(rv == HASHT_NOT_FOUND);
+    }
+    assert(ht.nelements == n - n / 5);
+    //while iterating, every pair must still be visited exactly once
+    //with robin hood the backward shift moves pairs into buckets the iterator has passed
+    char *visited = calloc(n, 1);
+    assert(visited);
+    struct hasht_iter iter;
+    long nremoved = 0;
+    for (rv = hasht_begin_iterator(&ht, &iter); rv == HASHT_OK; rv = hasht_iter_next(&ht, &iter)) {
+        int key = iter.pair->key;
+        assert(key >= 0 && key < n && key % 5 != 0 && !visited[key]);
+        visited[key] = 1;
+        if (key % 2 == 0) {
+            rv = hasht_remove_iter(&ht, &iter);
+            assert(rv == HASHT_OK);
+            nremoved++;
+        }
+    }
+    assert(rv == HASHT_ITER_STOP);
+    for (int i=0; i<n; i++)
+        assert(visited[i] == (i % 5 != 0));
+    assert(ht.nelements == n - n / 5 - nremoved);
+    for (int i=0; i<n; i++) {
+        rv = hasht_find(&ht, &i, &iter);
+        assert(rv == ((i % 5 != 0 && i % 2 != 0) ? HASHT_OK : HASHT_NOT_FOUND));
+    }
+    free(visited);
+    hasht_deinit(&ht);
+}
+
+void test_try_emplace(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    //counting, every key is seen i % 7 + 1 times, in rounds so the table resizes between repeats
+    const int n = 3000;
+    for (int round=0; round<7; round++) {
+        for (int i=0; i<n; i++) {
+            if (i % 7 < round)
+                continue;
+            struct hasht_iter iter;
+            bool inserted;
+            hash_calls = 0;
+            rv = hasht_try_emplace(&ht, &i, NULL, &iter, &inserted);
+            assert(rv == HASHT_OK);
+            assert(inserted == (round == 0));
+            assert(iter.pair->key == i);
+            assert(inserted ? *iter.value == 0 : *iter.value == round);
+#if !defined(HASHT_INCREMENTAL_RESIZE) && !defined(HASHT_STORE_HASH)
+            assert(hash_calls == 1 || inserted); //inserting can resize, which hashes the keys again
+#endif
+            (*iter.value)++;
+        }
+    }
+    assert(ht.nelements == n);
+    for (int i=0; i<n; i++) {
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &i, &iter);
+        assert(rv == HASHT_OK && *iter.value == i % 7 + 1);
+    }
+    //a given initial value, an existing value is never replaced
+    int key = n, init = 42;
+    struct hasht_iter iter;
+    bool inserted;
+    rv = hasht_try_emplace(&ht, &key, &init, &iter, &inserted);
+    assert(rv == HASHT_OK && inserted && *iter.value == 42);
+    init = 43;
+    rv = hasht_try_emplace(&ht, &key, &init, &iter, &inserted);
+    assert(rv == HASHT_OK && !inserted && *iter.value == 42);
+    assert(ht.nelements == n + 1);
+    hasht_deinit(&ht);
+}
+
+void test_parallel_resize(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    ht.resize_nthreads = 4;
+    //enough for a few resizes above HASHT_PARALLEL_RESIZE_MIN, runs of consecutive keys cross the thread's ranges
+    const int n = (int) HASHT_PARALLEL_RESIZE_MIN * 5;
+    for (int i=0; i<n; i++) {
+        int key = (i % 100 < 70) ? i : (int) (((unsigned) i * 2654435761U) & 0x3FFFFFFF) + n;
+        rv = hasht_insert(&ht, &key, &i);
+        assert(rv == HASHT_OK);
+    }
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(&ht);
+    assert(rv == HASHT_OK);
+#endif
+    assert(ht.resize_nthreads == 4); //kept across resizes
+    assert(ht.nelements == n);
+    for (int i=0; i<n; i++) {
+        int key = (i % 100 < 70) ? i : (int) (((unsigned) i * 2654435761U) & 0x3FFFFFFF) + n;
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK);
+        assert(*iter.value == i);
+    }
+    test_iter_expect_count(&ht, n);
+    hasht_deinit(&ht);
+}
+
+#ifdef HASHT_THREADS
+#define SHARDED_NTHREADS 4
+#define SHARDED_PER_THREAD 5000
+struct sharded_test_arg {
+    struct hasht_sharded *sh;
+    int t;
+};
+void *sharded_test_worker(void *varg) {
+    struct sharded_test_arg *arg = (struct sharded_test_arg *) varg;
+    //each thread owns the keys congruent to t, but they all land in every shard
+    for (int i=0; i<SHARDED_PER_THREAD; i++) {
+        int key = i * SHARDED_NTHREADS + arg->t;
+        int rv = hasht_sharded_insert(arg->sh, &key, &key);
+        assert(rv == HASHT_OK);
+    }
+    for (int i=0; i<SHARDED_PER_THREAD; i++) {
+        int key = i * SHARDED_NTHREADS + arg->t;
+        int value = -1;
+        int rv = hasht_sharded_find(arg->sh, &key, &value);
+        assert(rv == HASHT_OK && value == key);
+        if (i % 2) {
+            rv = hasht_sharded_remove(arg->sh, &key);
+            assert(rv == HASHT_OK);
+        }
+    }
+    return NULL;
+}
+void test_sharded(void) {
+    struct hasht_sharded sh;
+#ifdef HASHT_DATA_ARG
+    int rv = hasht_sharded_init_ex(&sh, 6, 0, hasht_def_malloc, hasht_def_realloc, hasht_def_free, mydata, 20, 60);
+#else
+    int rv = hasht_sharded_init(&sh, 6, 0);
+#endif
+    assert(rv == HASHT_OK);
+    assert(sh.nshards == 8);
+    pthread_t threads[SHARDED_NTHREADS];
+    struct sharded_test_arg args[SHARDED_NTHREADS];
+    for (int t=0; t<SHARDED_NTHREADS; t++) {
+        args[t].sh = &sh;
+        args[t].t = t;
+        rv = pthread_create(threads + t, NULL, sharded_test_worker, args + t);
+        assert(rv == 0);
+    }
+    for (int t=0; t<SHARDED_NTHREADS; t++)
+        pthread_join(threads[t], NULL);
+
+    assert(hasht_sharded_nelements(&sh) == SHARDED_NTHREADS * SHARDED_PER_THREAD / 2);
+    long nonempty_shards = 0;
+    for (long i=0; i<sh.nshards; i++)
+        nonempty_shards += sh.shards[i].s.ht.nelements > 0;
+    assert(nonempty_shards == sh.nshards);
+    for (int key=0; key<SHARDED_NTHREADS * SHARDED_PER_THREAD; key++) {
+        int value;
+        rv = hasht_sharded_find(&sh, &key, &value);
+        assert(rv == (((key / SHARDED_NTHREADS) % 2) ? HASHT_NOT_FOUND : HASHT_OK));
+    }
+    int key = 0, value = 7;
+    rv = hasht_sharded_insert(&sh, &key, &value);
+    assert(rv == HASHT_DUPLICATE_KEY);
+    rv = hasht_sharded_insert_or_replace(&sh, &key, &value);
+    assert(rv == HASHT_OK);
+    rv = hasht_sharded_find(&sh, &key, &value);
+    assert(rv == HASHT_OK && value == 7);
+
+    //emptying the shards shrinks them back
+    long nbuckets_full[8]; //sh.nshards, see above
+    for (long i=0; i<sh.nshards; i++)
+        nbuckets_full[i] = sh.shards[i].s.ht.nbuckets;
+    for (key=0; key<SHARDED_NTHREADS * SHARDED_PER_THREAD; key++) {
+        rv = hasht_sharded_remove(&sh, &key);
+        assert(rv == (((key / SHARDED_NTHREADS) % 2) ? HASHT_NOT_FOUND : HASHT_OK));
+    }
+    assert(hasht_sharded_nelements(&sh) == 0);
+    for (long i=0; i<sh.nshards; i++)
+        assert(sh.shards[i].s.ht.nbuckets < nbuckets_full[i]);
+    hasht_sharded_deinit(&sh);
+}
+#endif // HASHT_THREADS
+
+#ifdef HASHT_SWMR
+#define SWMR_NKEYS 30000
+#define SWMR_NREADERS 3
+struct swmr_test_arg {
+    struct hasht_swmr *sw;
+    _Atomic int *ninserted; //keys below this are in the table, it's lowered before the keys above it are removed
+    _Atomic bool *done;
+    long nfound;
+};
+void *swmr_test_reader(void *varg) {
+    struct swmr_test_arg *arg = (struct swmr_test_arg *) varg;
+    int id = hasht_swmr_reader_register(arg->sw);
+    assert(id >= 0);
+    unsigned int rnd = 12345;
+    while (!atomic_load(arg->done)) {
+        int n = atomic_load(arg->ninserted);
+        if (n == 0)
+            continue;
+        rnd = rnd * 1103515245U + 12345U;
+        int key = (int) (rnd >> 8) % n;
+        int value = -1;
+        int rv = hasht_swmr_find(arg->sw, id, &key, &value);
+        assert((rv == HASHT_OK && value == key) || key >= atomic_load(arg->ninserted));
+        key = 3 * SWMR_NKEYS + key; //never inserted
+        rv = hasht_swmr_find(arg->sw, id, &key, &value);
+        assert(rv == HASHT_NOT_FOUND);
+        arg->nfound++;
+    }
+    hasht_swmr_reader_unregister(arg->sw, id);
+    return NULL;
+}
+void test_swmr(void) {
+    struct hasht_swmr sw;
+#ifdef HASHT_DATA_ARG
+    int rv = hasht_swmr_init_ex(&sw, 0, hasht_def_malloc, hasht_def_realloc, hasht_def_free, mydata, 20, 60);
+#else
+    int rv = hasht_swmr_init(&sw, 0);
+#endif
+    assert(rv == HASHT_OK);
+    _Atomic int ninserted = 0;
+    _Atomic bool done = false;
+    pthread_t threads[SWMR_NREADERS];
+    struct swmr_test_arg args[SWMR_NREADERS];
+    for (int t=0; t<SWMR_NREADERS; t++) {
+        struct swmr_test_arg arg = { &sw, &ninserted, &done, 0 };
+        args[t] = arg;
+        rv = pthread_create(threads + t, NULL, swmr_test_reader, args + t);
+        assert(rv == 0);
+    }
+    long first_nbuckets = atomic_load(&sw.cur)->nbuckets;
+    for (int i=0; i<SWMR_NKEYS; i++) {
+        rv = hasht_swmr_insert(&sw, &i, &i);
+        assert(rv == HASHT_OK);
+        rv = hasht_swmr_insert_or_replace(&sw, &i, &i); //rewrites the pair in place
+        assert(rv == HASHT_OK);
+        atomic_store(&ninserted, i + 1);
+        //churn right next to the keys the readers look for
+        int other = SWMR_NKEYS + i;
+        rv = hasht_swmr_insert(&sw, &other, &other);
+        assert(rv == HASHT_OK);
+        if (i % 4) {
+            rv = hasht_swmr_remove(&sw, &other);
+            assert(rv == HASHT_OK);
+        }
+    }
+    long full_nbuckets = atomic_load(&sw.cur)->nbuckets;
+    assert(full_nbuckets > first_nbuckets); //it grew, readers kept going
+    assert(atomic_load(&sw.cur)->nelements == SWMR_NKEYS + SWMR_NKEYS / 4);
+
+    //removing most of it shrinks into a new table the same way
+    atomic_store(&ninserted, SWMR_NKEYS / 16);
+    for (int i=0; i<SWMR_NKEYS; i++) {
+        if (i >= SWMR_NKEYS / 16) {
+            rv = hasht_swmr_remove(&sw, &i);
+            assert(rv == HASHT_OK);
+        }
+        int other = SWMR_NKEYS + i;
+        rv = hasht_swmr_remove(&sw, &other);
+        assert(rv == ((i % 4) ? HASHT_NOT_FOUND : HASHT_OK));
+    }
+    atomic_store(&done, true);
+    for (int t=0; t<SWMR_NREADERS; t++)
+        pthread_join(threads[t], NULL);
+    assert(atomic_load(&sw.cur)->nbuckets < full_nbuckets);
+    hasht_swmr_reclaim(&sw);
+    assert(sw.retired == NULL); //no reader is left
+    assert(atomic_load(&sw.cur)->nelements == SWMR_NKEYS / 16);
+    hasht_swmr_deinit(&sw);
+}
+#endif // HASHT_SWMR
+
+//an allocator that leaves garbage behind, so buckets that are assumed zero but aren't get noticed
+static long zalloc_calls = 0;
+static void *garbage_alloc(size_t sz, void *userdata) {
+    (void) userdata;
+    void *m = malloc(sz);
+    if (m)
+        memset(m, 0xa5, sz);
+    return m;
+}
+static void *counting_zalloc(size_t sz, void *userdata) {
+    (void) userdata;
+    zalloc_calls++;
+    return calloc(1, sz);
+}
+
+void test_zalloc(void) {
+    struct hasht ht;
+    int rv = hasht_init(&ht, 0);
+    assert(rv == HASHT_OK && ht.memfuncs.zalloc == hasht_def_zalloc);
+    hasht_deinit(&ht);
+
+    //other allocators clear the buckets themselves
+    rv = hasht_init_ex(&ht, 0, garbage_alloc, hasht_def_realloc, hasht_def_free, NULL, 20, 60);
+    assert(rv == HASHT_OK && ht.memfuncs.zalloc == NULL);
+#ifdef HASHT_DATA_ARG
+    ht.userdata = mydata;
+#endif
+    test_insert_all_arr2(&ht, values, arr1_sz);
+    test_find_all_arr2(&ht, values, arr1_sz);
+    //unless they have a zalloc too, which is used from then on for tables that don't fill up right away
+    ht.memfuncs.zalloc = counting_zalloc;
+    struct hasht copy;
+    rv = hasht_init_copy_settings(&copy, 10, &ht);
+    assert(rv == HASHT_OK && zalloc_calls == 1);
+    hasht_deinit(&copy);
+    rv = hasht_resize_nbuckets__(&ht, ht.nbuckets * 4);
+    assert(rv == HASHT_OK);
+#if defined(HASHT_HUGE_PAGES)
+    //big enough to be mapped (zero anyway), or not
+#elif defined(HASHT_INCREMENTAL_RESIZE)
+    assert(zalloc_calls == 2);
+#else
+    assert(zalloc_calls == 1); //the copy writes all over the new table right away, clearing it first is faster
+#endif
+    test_insert_all_arr2(&ht, values2, arr2_sz);
+    test_find_all_arr2(&ht, values, arr1_sz);
+    test_delete_all_arr2(&ht, values, arr1_sz);
+    test_find_all_arr2(&ht, values2, arr2_sz);
+    test_iter_expect_seen(&ht, values2, arr2_sz, arr2_sz);
+    hasht_deinit(&ht);
+}
+
+#ifdef HASHT_HUGE_PAGES
+static void check_bkt_mem(struct hasht *ht) {
+    assert((uintptr_t) ht->tab % HASHT_CACHE_LINE == 0);
+    assert(ht->tab_mem.mapped_sz == 0 || hasht_tab_alloc_sz(ht->nbuckets) >= HASHT_HUGE_PAGE_MIN);
+#ifdef HASHT_SOA
+    assert((uintptr_t) ht->values % HASHT_CACHE_LINE == 0);
+#endif
+}
+
+void test_huge_pages(void) {
+    //one table too small to be mapped, and one big enough
+    long sizes[] = { 0, HASHT_HUGE_PAGE_MIN / (long) sizeof(struct hasht_pair_type) };
+    for (int s=0; s<2; s++) {
+        struct hasht ht;
+        test_init_table(&ht, sizes[s]);
+        check_bkt_mem(&ht);
+        assert(s == 1 || ht.tab_mem.mapped_sz == 0);
+        long nbuckets = ht.nbuckets;
+        test_insert_all_arr2(&ht, values, arr1_sz);
+        test_insert_all_arr2(&ht, values2, arr2_sz);
+        //the small one grew, into new arrays
+        assert(s == 1 || ht.nbuckets != nbuckets);
+        check_bkt_mem(&ht);
+        test_find_all_arr2(&ht, values, arr1_sz);
+        test_delete_all_arr2(&ht, values, arr1_sz);
+        test_find_all_arr2(&ht, values2, arr2_sz);
+        hasht_deinit(&ht);
+    }
+}
+#endif // HASHT_HUGE_PAGES
+
+#ifdef HASHT_SNAPSHOT
+static int snapshot_open(struct hasht *ht, const char *path, bool verify_data) {
+    int rv = hasht_open_mapped(ht, path, verify_data);
+#ifdef HASHT_DATA_ARG
+    if (rv == HASHT_OK)
+        ht->userdata = mydata;
+#endif
+    return rv;
+}
+
+void test_snapshot(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    //reserved, so deleting doesn't shrink it, and inserting the deleted ones again later fits in the mapping
+    rv = hasht_reserve(&ht, arr1_sz + arr2_sz);
+    assert(rv == HASHT_OK);
+    test_insert_all_arr2(&ht, values, arr1_sz);
+    test_insert_all_arr2(&ht, values2, arr2_sz);
+    test_delete_all_arr2(&ht, values, arr1_sz); //deleted buckets are saved as they are
+
+    char path[] = "/tmp/hasht_test_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    rv = hasht_save(&ht, fd);
+    assert(rv == HASHT_OK);
+    close(fd);
+    long nbuckets = ht.nbuckets;
+    hasht_deinit(&ht);
+
+    struct hasht mapped;
+    rv = snapshot_open(&mapped, path, true);
+    assert(rv == HASHT_OK);
+    assert(mapped.mapping && mapped.nbuckets == nbuckets && mapped.nelements == arr2_sz);
+    test_find_all_arr2(&mapped, values2, arr2_sz);
+    for (int i=0; i<arr1_sz; i++) {
+        struct hasht_iter iter;
+        rv = hasht_find(&mapped, &values[i][0], &iter);
+        assert(rv == HASHT_NOT_FOUND);
+    }
+    test_iter_expect_seen(&mapped, values2, arr2_sz, arr2_sz);
+
+    //writes only change the private copy
+    test_insert_all_arr2(&mapped, values, arr1_sz);
+    assert(mapped.mapping);
+    //and growing moves it off the file
+    for (int key=20000; key<20000 + 4 * nbuckets; key++) {
+        rv = hasht_insert(&mapped, &key, &key);
+        assert(rv == HASHT_OK);
+    }
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(&mapped);
+    assert(rv == HASHT_OK);
+#endif
+    assert(!mapped.mapping && mapped.nbuckets > nbuckets);
+    test_find_all_arr2(&mapped, values, arr1_sz);
+    test_find_all_arr2(&mapped, values2, arr2_sz);
+    hasht_deinit(&mapped);
+    rv = snapshot_open(&mapped, path, true);
+    assert(rv == HASHT_OK && mapped.nelements == arr2_sz);
+    test_delete_all_arr2(&mapped, values2, arr2_sz);
+    assert(mapped.nelements == 0 && mapped.mapping);
+    hasht_deinit(&mapped);
+
+    //a damaged bucket is only noticed when the data is verified
+    FILE *f = fopen(path, "r+b");
+    assert(f);
+    fseek(f, HASHT_SNAPSHOT_DATA_OFF + 3, SEEK_SET);
+    int c = fgetc(f);
+    fseek(f, HASHT_SNAPSHOT_DATA_OFF + 3, SEEK_SET);
+    fputc(c ^ 0x5a, f);
+    fclose(f);
+    rv = snapshot_open(&mapped, path, true);
+    assert(rv == HASHT_BAD_SNAPSHOT);
+    rv = snapshot_open(&mapped, path, false);
+    assert(rv == HASHT_OK);
+    hasht_deinit(&mapped);
+
+    //a damaged header or a truncated file never is
+    rv = truncate(path, HASHT_SNAPSHOT_DATA_OFF + 10);
+    assert(rv == 0);
+    rv = snapshot_open(&mapped, path, false);
+    assert(rv == HASHT_BAD_SNAPSHOT);
+    unlink(path);
+    rv = snapshot_open(&mapped, path, false);
+    assert(rv == HASHT_IO_ERR);
+}
+#endif // HASHT_SNAPSHOT
+
+void test_replace(void) {
+    //replacing keeps a single copy of the key, robin hood used to displace the old pair and leave it behind
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    test_insert_all_arr2(&ht, values, arr1_sz);
+    for (int i=0; i<arr1_sz; i++) {
+        int value = values[i][1] + 1;
+        struct hasht_iter iter;
+        rv = hasht_find_or_insert(&ht, &values[i][0], &value, &iter);
+        assert(rv == HASHT_OK && *iter.value == value);
+    }
+    assert(ht.nelements == arr1_sz);
+    for (int i=0; i<arr1_sz; i++) {
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &values[i][0], &iter);
+        assert(rv == HASHT_OK && *iter.value == values[i][1] + 1);
+    }
+    //a leftover copy would still be found after removing the key
+    for (int i=0; i<arr1_sz; i++) {
+        struct hasht_iter iter;
+        rv = hasht_remove(&ht, &values[i][0]);
+        assert(rv == HASHT_OK);
+        rv = hasht_find(&ht, &values[i][0], &iter);
+        assert(rv == HASHT_NOT_FOUND);
+    }
+    assert(ht.nelements == 0);
+    hasht_deinit(&ht);
+}
+
+void test_size_math(void) {
+    //thresholds and sizes of huge tables must not overflow
+    long big = LONG_MAX / 50;
+    long grow_at = hasht_mul_div(big, 60, 100);
+    assert(grow_at > 0 && grow_at < big);
+    long nbuckets = hasht_calc_nelements_to_nbuckets(big / 4, 20, 60);
+    assert(nbuckets > big / 4);
+    assert(hasht_mul_div(LONG_MAX, 100, 20) == LONG_MAX);
+
+#if defined(HASHT_64BIT) && !defined(HASHT_POW2)
+    //a size past the end of the 32 bit ladder, without allocating it
+    struct hasht ht;
+    ht.shrink_at_percentage = 20;
+    ht.grow_at_percentage = 60;
+    int rv = hasht_change_sz_field(&ht, 3000000000L, false);
+    assert(rv == HASHT_OK);
+    assert(ht.nbuckets >= 3000000000L);
+    assert(ht.grow_at_gt_n > ht.shrink_at_lt_n);
+    size_t hash = 0x9E3779B97F4A7C15LLU;
+    for (int i=0; i<1000; i++) {
+        hash = hash * 6364136223846793005LLU + 1442695040888963407LLU;
+        assert(hasht_integer_mod_buckets(&ht, hash) == (long) (hash % ht.nbuckets));
+    }
+#endif
+#ifdef HASHT_POW2
+    //sizes are exact powers of two and every hash lands inside the table
+    struct hasht pt;
+    pt.shrink_at_percentage = 20;
+    pt.grow_at_percentage = 60;
+    for (long want = 5; want < 100000; want = want * 3 + 1) {
+        int prv = hasht_change_sz_field(&pt, want, false);
+        assert(prv == HASHT_OK);
+        assert(pt.nbuckets >= want && pt.nbuckets < want * 2);
+        assert((pt.nbuckets & (pt.nbuckets - 1)) == 0);
+        for (size_t h = 0; h < 1000; h++) {
+            long idx = hasht_integer_mod_buckets(&pt, h);
+            assert(idx >= 0 && idx < pt.nbuckets);
+        }
+    }
+#endif
+}
+
+void test_capacity(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    const int n = 20000;
+    rv = hasht_reserve(&ht, -1);
+    assert(rv == HASHT_INVALID_REQ_SZ);
+    rv = hasht_reserve(&ht, n);
+    assert(rv == HASHT_OK && ht.grow_at_gt_n > n);
+    long reserved = ht.nbuckets;
+    for (int key=0; key<n; key++) {
+        rv = hasht_insert(&ht, &key, &key);
+        assert(rv == HASHT_OK);
+    }
+    assert(ht.nbuckets == reserved);
+    //removing everything but a few keeps the reserved size
+    for (int key=0; key<n - 10; key++) {
+        rv = hasht_remove(&ht, &key);
+        assert(rv == HASHT_OK);
+    }
+    assert(ht.nbuckets == reserved);
+
+    //until it's let go
+    rv = hasht_shrink_to_fit(&ht, false);
+    assert(rv == HASHT_OK && ht.nbuckets < reserved && ht.nelements == 10);
+    rv = hasht_shrink_to_fit(&ht, false);
+    assert(rv == HASHT_RESIZE_REFUSE);
+    for (int key=n - 10; key<n; key++) {
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK && *iter.value == key);
+    }
+
+    //growing and removing again shrinks on its own now, down to about what it was created with
+    long small = ht.nbuckets;
+    for (int key=0; key<n - 10; key++) {
+        rv = hasht_insert(&ht, &key, &key);
+        assert(rv == HASHT_OK);
+    }
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(&ht);
+    assert(rv == HASHT_OK);
+#endif
+    long grown = ht.nbuckets;
+    assert(grown > small);
+    for (int key=0; key<n - 10; key++) {
+        rv = hasht_remove(&ht, &key);
+        assert(rv == HASHT_OK);
+    }
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(&ht);
+    assert(rv == HASHT_OK);
+#endif
+    assert(ht.nbuckets < grown && ht.nelements == 10);
+    test_iter_expect_count(&ht, 10);
+
+    //forced, it goes as small as the grow threshold allows
+    long before_force = ht.nbuckets;
+    rv = hasht_shrink_to_fit(&ht, true);
+    assert(rv == HASHT_OK && ht.nbuckets <= before_force && ht.nelements < ht.grow_at_gt_n);
+    test_iter_expect_count(&ht, 10);
+
+    //rehash: too small for the grow threshold is refused, unless forced, too small for the elements never works
+    rv = hasht_rehash(&ht, 11, false);
+    assert(rv == HASHT_RESIZE_REFUSE || rv == HASHT_INVALID_REQ_SZ);
+    rv = hasht_rehash(&ht, 5, true);
+    assert(rv == HASHT_INVALID_REQ_SZ);
+    rv = hasht_rehash(&ht, 1000, false);
+    assert(rv == HASHT_OK && ht.nbuckets >= 1000 && ht.min_nbuckets == ht.nbuckets);
+    long rehashed = ht.nbuckets;
+    //the same size again only clears out the deleted buckets
+    for (int key=n - 10; key<n - 5; key++) {
+        rv = hasht_remove(&ht, &key);
+        assert(rv == HASHT_OK);
+    }
+    rv = hasht_rehash(&ht, rehashed, false);
+    assert(rv == HASHT_OK && ht.nbuckets == rehashed);
+    for (int key=n - 5; key<n; key++) {
+        struct hasht_iter iter;
+        rv = hasht_find(&ht, &key, &iter);
+        assert(rv == HASHT_OK && *iter.value == key);
+    }
+    test_iter_expect_count(&ht, 5);
+    hasht_deinit(&ht);
+}
+
+#ifdef HASHT_STATS
+static long probe_hist_sum(struct hasht_stats *st) {
+    long sum = 0;
+    for (int i=0; i<HASHT_STATS_PROBE_HIST; i++)
+        sum += st->probe_len_hist[i];
+    return sum;
+}
+
+void test_stats(void) {
+    struct hasht ht;
+    test_init_table(&ht, 0);
+    int rv;
+    struct hasht_stats st;
+    hasht_get_stats(&ht, &st);
+    assert(st.finds == 0 && st.resizes == 0 && probe_hist_sum(&st) == 0);
+
+    //keys with the same low bits (the partial hash, and the control byte) and the same bucket, the fingerprint can't tell
+    //them apart. There are more candidates than buckets, so two of them always share one
+    rv = hasht_rehash(&ht, 64, true);
+    assert(rv == HASHT_OK && ht.nbuckets < 256);
+    long in_bucket[256];
+    for (int i=0; i<256; i++)
+        in_bucket[i] = LONG_MAX;
+    int key_a = 0, key_b = 0;
+    for (int j=-128; j<128; j++) {
+        int key = 7 + j * (1 << 24);
+        long idx = hasht_integer_mod_buckets(&ht, hasht_hash__(&ht, &key));
+        if (in_bucket[idx] != LONG_MAX) {
+            key_a = (int) in_bucket[idx];
+            key_b = key;
+            break;
+        }
+        in_bucket[idx] = key;
+    }
+    assert(key_a != key_b);
+    rv = hasht_insert(&ht, &key_a, &key_a);
+    assert(rv == HASHT_OK);
+    struct hasht_iter iter;
+    rv = hasht_find(&ht, &key_a, &iter);
+    assert(rv == HASHT_OK);
+    rv = hasht_find(&ht, &key_b, &iter);
+    assert(rv == HASHT_NOT_FOUND);
+    hasht_get_stats(&ht, &st);
+    assert(st.finds == 2 && st.hits == 1 && st.misses == 1);
+    assert(probe_hist_sum(&st) == 3 && st.probe_len_hist[0] >= 2); //inserting looks up too, but isn't a find
+    assert(st.resizes == 1 && st.resize_bytes > 0 && st.resize_ns >= 0);
+#ifdef HASHT_STORE_HASH
+    assert(st.fingerprint_false_positives == 0); //the whole hash is compared first, and here it's the key itself
+#else
+    assert(st.fingerprint_false_positives == 1);
+#endif
+
+    //the counters stay with the table when it grows
+    const int n = 5000;
+    for (int key=1; key<=n; key++) {
+        rv = hasht_insert(&ht, &key, &key);
+        assert(rv == HASHT_OK);
+    }
+#ifdef HASHT_INCREMENTAL_RESIZE
+    rv = hasht_finish_resize(&ht);
+    assert(rv == HASHT_OK);
+#endif
+    hasht_get_stats(&ht, &st);
+    assert(st.finds == 2 && st.resizes > 1 && probe_hist_sum(&st) >= n + 3);
+#ifndef HASHT_ROBIN_HOOD
+    long resizes = st.resizes;
+#endif
+
+    //removing leaves deleted buckets behind (but never with robin hood)
+    for (int key=1; key<=n; key += 2) {
+        rv = hasht_remove(&ht, &key);
+        assert(rv == HASHT_OK);
+    }
+    hasht_get_stats(&ht, &st);
+#ifdef HASHT_ROBIN_HOOD
+    assert(st.tombstones_created == 0 && st.tombstones_reclaimed == 0);
+#else
+    assert(st.tombstones_created > 0);
+    if (st.resizes == resizes) {
+        //nothing was dropped by a shrink
+        assert(st.tombstones_created - st.tombstones_reused - st.tombstones_reclaimed - st.tombstones_purged == ht.ndeleted);
+    }
+    long ndeleted = ht.ndeleted;
+    long purged = st.tombstones_purged;
+    rv = hasht_purge_deleted(&ht);
+    assert(rv == HASHT_OK);
+    hasht_get_stats(&ht, &st);
+    assert(st.tombstones_purged == purged + ndeleted);
+#endif
+    hasht_deinit(&ht);
+
+#ifdef HASHT_THREADS
+    struct hasht_sharded sh;
+    rv = hasht_sharded_init(&sh, 4, 0);
+    assert(rv == HASHT_OK);
+    for (int key=0; key<1000; key++) {
+        rv = hasht_sharded_insert(&sh, &key, &key);
+        assert(rv == HASHT_OK);
+    }
+    for (int key=0; key<1500; key++) {
+        int value;
+        rv = hasht_sharded_find(&sh, &key, &value);
+        assert(rv == (key < 1000 ? HASHT_OK : HASHT_NOT_FOUND));
+    }
+    hasht_sharded_get_stats(&sh, &st);
+    assert(st.finds == 1500 && st.hits == 1000 && st.misses == 500);
+    hasht_sharded_deinit(&sh);
+#endif
+}
+#endif
+
 int main(void) {
     test_init_add_arrays_find();
+    test_size_math();
+    test_replace();
+    test_churn_purges_deleted();
+    test_find_batch();
+    test_build_from_arrays();
+    test_hashed_api();
+    test_remove_iter();
+    test_try_emplace();
+    test_zalloc();
+    test_capacity();
+    test_parallel_resize();
+#ifdef HASHT_PROBE
+    test_find_as();
+#endif
+#ifdef HASHT_THREADS
+    test_sharded();
+#endif
+#ifdef HASHT_SWMR
+    test_swmr();
+#endif
+#ifdef HASHT_ROBIN_HOOD
+    test_robin_hood_churn();
+#endif
+#ifdef HASHT_INCREMENTAL_RESIZE
+    test_incremental_resize();
+#endif
+#ifdef HASHT_STORE_HASH
+    test_store_hash_no_rehash();
+#endif
+#ifdef HASHT_HUGE_PAGES
+    test_huge_pages();
+#endif
+#ifdef HASHT_SNAPSHOT
+    test_snapshot();
+#endif
+#ifdef HASHT_STATS
+    test_stats();
+#endif
     printf("success\n");
 }